@@ -12,4 +12,6 @@ enum Assembler_AddressingMode {
     RELATIVE
 };
 
+constexpr unsigned AddressingModeCount = Assembler_AddressingMode::RELATIVE + 1;
+
 #endif //M68HC11_ADDRESSINGMODE_H
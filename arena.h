@@ -0,0 +1,76 @@
+#ifndef M68HC11_ARENA_H
+#define M68HC11_ARENA_H
+
+#include "m68hc11x.h"
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+// Bump allocator. Individual frees are no-ops; everything handed out is reclaimed at once by Rewind(), which keeps the
+// blocks around so the next pass reuses the same memory instead of going back to the heap.
+class Arena : public std::pmr::memory_resource {
+public:
+    static constexpr sz_t DefaultBlockSize = 256 * 1024;
+
+    explicit Arena(sz_t blockSize = DefaultBlockSize) : blockSize(blockSize) {}
+
+    Arena(const Arena &) = delete;
+    Arena &operator=(const Arena &) = delete;
+
+    void Rewind() {
+        current = 0;
+        used = 0;
+    }
+
+    [[nodiscard]] sz_t Capacity() const {
+        sz_t capacity = 0;
+        for (const Block &block : blocks)
+            capacity += block.size;
+
+        return capacity;
+    }
+
+private:
+    struct Block {
+        std::unique_ptr<std::byte[]> data;
+        sz_t size;
+    };
+
+    void *do_allocate(sz_t bytes, sz_t alignment) override {
+        while (current < blocks.size()) {
+            Block &block = blocks[current];
+            const sz_t start = (used + alignment - 1) & ~(alignment - 1);
+
+            if (start + bytes <= block.size) {
+                used = start + bytes;
+                return block.data.get() + start;
+            }
+
+            current++;
+            used = 0;
+        }
+
+        // NOTE: blocks come from operator new[] and are therefore aligned for any fundamental type
+        const sz_t size = std::max(blockSize, bytes + alignment);
+        blocks.push_back({ std::make_unique<std::byte[]>(size), size });
+        current = blocks.size() - 1;
+        used = bytes;
+
+        return blocks.back().data.get();
+    }
+
+    void do_deallocate(void *, sz_t, sz_t) override {}
+
+    [[nodiscard]] bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override {
+        return this == &other;
+    }
+
+    std::vector<Block> blocks;
+    sz_t blockSize;
+    sz_t current = 0;
+    sz_t used = 0;
+};
+
+#endif //M68HC11_ARENA_H
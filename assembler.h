@@ -2,1513 +2,2399 @@
 #define M68HC11_ASSEMBLER_H
 
 #include "addressingmode.h"
+#include "arena.h"
+#include "lexer.h"
 #include "m68hc11x.h"
+#include "mappedfile.h"
+#include "symboltable.h"
 #include <algorithm>
-#include <memory>
+#include <array>
+#include <deque>
+#include <initializer_list>
 #include <optional>
+#include <span>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 #include <sstream>
 #include <map>
-#include <functional>
+#include <memory_resource>
+#include <vector>
 #include <format>
 #include <iomanip>
 
-class CPUState {
-public:
-    union {
-        union {
-            u8 A;
-            u8 B;
-        };
+struct OpcodeBytes {
+    std::array<u8, 2> bytes{};
+    u8 count = 0;
 
-        u16 D;
-    };
+    constexpr OpcodeBytes() = default;
+
+    // NOTE: at most a page prefix (0x18, 0x1A or 0xCD) followed by the opcode itself
+    constexpr OpcodeBytes(std::initializer_list<u8> opcodes) : count(static_cast<u8>(opcodes.size())) {
+        if (opcodes.size() > bytes.size())
+            throw std::logic_error("Too many opcode bytes");
+
+        std::copy(opcodes.begin(), opcodes.end(), bytes.begin());
+    }
 
-    u16 IX;
-    u16 IY;
-    u16 SP;
-    u16 PC;
-    u8 Flags;
+    [[nodiscard]] constexpr const u8 *begin() const { return bytes.data(); }
+    [[nodiscard]] constexpr const u8 *end() const { return bytes.data() + count; }
+    [[nodiscard]] constexpr sz_t size() const { return count; }
 };
 
 struct Operation {
-    std::vector<u8> opcodes;
+    OpcodeBytes opcodes;
     u8 byteCount;
+    // NOTE: E-clock cycles for the whole instruction, page prefix included; branches take the same time whether
+    // they are taken or not
+    u8 cycles;
+    bool supported = false;
 };
 
+struct OperationDef {
+    Assembler_AddressingMode mode;
+    Operation operation;
+};
+
+// NOTE: instructions are plain constexpr data so the whole ISA lives in read-only storage, with the encoding for
+// each addressing mode found by indexing rather than by a map lookup. What an instruction does is up to the emulator
+// (cpu.h), which matches its handlers to these entries by mnemonic.
 struct Instruction {
-    using Ptr = std::shared_ptr<Instruction>;
-    using OpcodeMap = std::unordered_map<Assembler_AddressingMode, Operation>;
-    using ExecuteFn = std::function<void(CPUState &)>;
+    using OpcodeMap = std::array<Operation, AddressingModeCount>;
 
-    std::string mnemonic;
-    std::string description;
+    std::string_view mnemonic;
+    std::string_view description;
     OpcodeMap opcodes;
-    ExecuteFn execute;
 
-    bool IsAddressingModeSupported(Assembler_AddressingMode mode) const {
-        return opcodes.count(mode);
+    [[nodiscard]] constexpr bool IsAddressingModeSupported(Assembler_AddressingMode mode) const {
+        return opcodes[mode].supported;
     }
 
-    static Ptr Create(std::string mnemonic, std::string description, OpcodeMap opcodes, ExecuteFn execute) {
-        return std::make_shared<Instruction>(Instruction{
-            std::move(mnemonic),
-            std::move(description),
-            std::move(opcodes),
-            std::move(execute)
-        });
+    [[nodiscard]] constexpr const Operation &GetOperation(Assembler_AddressingMode mode) const {
+        return opcodes[mode];
     }
 
-    static Ptr Create(std::string mnemonic, OpcodeMap opcodes) {
-        return Create(mnemonic, "", opcodes);
+    static constexpr Instruction Create(std::string_view mnemonic, std::string_view description,
+                                        std::initializer_list<OperationDef> operations) {
+        Instruction instruction = { mnemonic, description, {} };
+
+        for (const OperationDef &def : operations) {
+            instruction.opcodes[def.mode] = def.operation;
+            instruction.opcodes[def.mode].supported = true;
+        }
+
+        return instruction;
     }
 
-    static Ptr Create(std::string mnemonic, std::string description, OpcodeMap opcodes) {
-        return Create(mnemonic, description, opcodes, [](CPUState&) {
-            throw std::runtime_error("Unimplemented instruction!");
-        });
+    static constexpr Instruction Create(std::string_view mnemonic, std::initializer_list<OperationDef> operations) {
+        return Create(mnemonic, "", operations);
     }
 };
 
-using InstructionRef = std::shared_ptr<const Instruction>;
+using InstructionRef = const Instruction *;
 
-inline std::vector<std::shared_ptr<Instruction>> AllInstructions = {
+inline constexpr auto AllInstructions = std::to_array<Instruction>({
         Instruction::Create(
                 "ORG",
                 {
-                        {Assembler_AddressingMode::EXTENDED, { {}, 0 }}
+                        {Assembler_AddressingMode::EXTENDED, { {}, 0, 0 }}
                 }
         ),
         Instruction::Create(
                 "RMB",
                 {
-                        {Assembler_AddressingMode::DIRECT, { {}, 0 }},
-                        {Assembler_AddressingMode::EXTENDED, { {}, 0 }},
+                        {Assembler_AddressingMode::DIRECT, { {}, 0, 0 }},
+                        {Assembler_AddressingMode::EXTENDED, { {}, 0, 0 }},
                 }
        ),
         Instruction::Create(
                 "ABA",
                 "Add accumulators",
                 {
-                    { Assembler_AddressingMode::INHERENT, { { 0x1B }, 0 } }
-                },
-                [](CPUState &state) {
-                    state.A = state.A + state.B;
+                    { Assembler_AddressingMode::INHERENT, { { 0x1B }, 0, 2 } }
                 }
         ),
         Instruction::Create(
                 "ABX",
                 "Add B to X",
                 {
-                        { Assembler_AddressingMode::INHERENT, { { 0x3A }, 0 } }
+                        { Assembler_AddressingMode::INHERENT, { { 0x3A }, 0, 3 } }
                 }
         ),
         Instruction::Create(
                 "ABY",
                 "Add B to Y",
                 {
-                        { Assembler_AddressingMode::INHERENT, { { 0x18, 0x3A }, 0 } }
+                        { Assembler_AddressingMode::INHERENT, { { 0x18, 0x3A }, 0, 4 } }
                 }
         ),
         Instruction::Create (
                 "ADCA",
                 "Add with Carry to A",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE, { { 0x89 },          1 } },
-                        { Assembler_AddressingMode::DIRECT,    { { 0x99 },          1 } },
-                        { Assembler_AddressingMode::EXTENDED,  { { 0xB9 },          2 } },
-                        { Assembler_AddressingMode::INDEXED_X, { { 0xA9 },          1 } },
-                        { Assembler_AddressingMode::INDEXED_Y, { { 0x18, 0xA9 },    1 } },
+                        { Assembler_AddressingMode::IMMEDIATE, { { 0x89 },          1, 2 } },
+                        { Assembler_AddressingMode::DIRECT,    { { 0x99 },          1, 3 } },
+                        { Assembler_AddressingMode::EXTENDED,  { { 0xB9 },          2, 4 } },
+                        { Assembler_AddressingMode::INDEXED_X, { { 0xA9 },          1, 4 } },
+                        { Assembler_AddressingMode::INDEXED_Y, { { 0x18, 0xA9 },    1, 5 } },
                 }
         ),
         Instruction::Create (
                 "ADCB",
                 "Add with Carry to B",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE, { { 0xC9 },          1 } },
-                        { Assembler_AddressingMode::DIRECT,    { { 0xD9 },          1 } },
-                        { Assembler_AddressingMode::EXTENDED,  { { 0xF9 },          2 } },
-                        { Assembler_AddressingMode::INDEXED_X, { { 0xE9 },          1 } },
-                        { Assembler_AddressingMode::INDEXED_Y, { { 0x18, 0xE9 },    1 } },
+                        { Assembler_AddressingMode::IMMEDIATE, { { 0xC9 },          1, 2 } },
+                        { Assembler_AddressingMode::DIRECT,    { { 0xD9 },          1, 3 } },
+                        { Assembler_AddressingMode::EXTENDED,  { { 0xF9 },          2, 4 } },
+                        { Assembler_AddressingMode::INDEXED_X, { { 0xE9 },          1, 4 } },
+                        { Assembler_AddressingMode::INDEXED_Y, { { 0x18, 0xE9 },    1, 5 } },
                 }
         ),
         Instruction::Create (
                 "ADDA",
                 "Add Memory to A",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE, { { 0x8B },          1 } },
-                        { Assembler_AddressingMode::DIRECT,    { { 0x9B },          1 } },
-                        { Assembler_AddressingMode::EXTENDED,  { { 0xBB },          2 } },
-                        { Assembler_AddressingMode::INDEXED_X, { { 0xAB },          1 } },
-                        { Assembler_AddressingMode::INDEXED_Y, { { 0x18, 0xAB },    1 } },
+                        { Assembler_AddressingMode::IMMEDIATE, { { 0x8B },          1, 2 } },
+                        { Assembler_AddressingMode::DIRECT,    { { 0x9B },          1, 3 } },
+                        { Assembler_AddressingMode::EXTENDED,  { { 0xBB },          2, 4 } },
+                        { Assembler_AddressingMode::INDEXED_X, { { 0xAB },          1, 4 } },
+                        { Assembler_AddressingMode::INDEXED_Y, { { 0x18, 0xAB },    1, 5 } },
                 }
         ),
         Instruction::Create (
                 "ADDB",
                 "Add Memory to B",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE, { { 0xCB },          1 } },
-                        { Assembler_AddressingMode::DIRECT,    { { 0xDB },          1 } },
-                        { Assembler_AddressingMode::EXTENDED,  { { 0xFB },          2 } },
-                        { Assembler_AddressingMode::INDEXED_X, { { 0xEB },          1 } },
-                        { Assembler_AddressingMode::INDEXED_Y, { { 0x18, 0xEB },    1 } },
+                        { Assembler_AddressingMode::IMMEDIATE, { { 0xCB },          1, 2 } },
+                        { Assembler_AddressingMode::DIRECT,    { { 0xDB },          1, 3 } },
+                        { Assembler_AddressingMode::EXTENDED,  { { 0xFB },          2, 4 } },
+                        { Assembler_AddressingMode::INDEXED_X, { { 0xEB },          1, 4 } },
+                        { Assembler_AddressingMode::INDEXED_Y, { { 0x18, 0xEB },    1, 5 } },
                 }
         ),
         Instruction::Create (
                 "ADDD",
                 "Add 16-Bit to D",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE, { { 0xC3 },          2 } },
-                        { Assembler_AddressingMode::DIRECT,    { { 0xD3 },          1 } },
-                        { Assembler_AddressingMode::EXTENDED,  { { 0xF3 },          2 } },
-                        { Assembler_AddressingMode::INDEXED_X, { { 0xE3 },          1 } },
-                        { Assembler_AddressingMode::INDEXED_Y, { { 0x18, 0xE3 },    1 } },
+                        { Assembler_AddressingMode::IMMEDIATE, { { 0xC3 },          2, 4 } },
+                        { Assembler_AddressingMode::DIRECT,    { { 0xD3 },          1, 5 } },
+                        { Assembler_AddressingMode::EXTENDED,  { { 0xF3 },          2, 6 } },
+                        { Assembler_AddressingMode::INDEXED_X, { { 0xE3 },          1, 6 } },
+                        { Assembler_AddressingMode::INDEXED_Y, { { 0x18, 0xE3 },    1, 7 } },
                 }
         ),
         Instruction::Create (
                 "ANDA",
                 "AND A with Memory",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE, { { 0x84 },          1 } },
-                        { Assembler_AddressingMode::DIRECT,    { { 0x94 },          1 } },
-                        { Assembler_AddressingMode::EXTENDED,  { { 0xB4 },          2 } },
-                        { Assembler_AddressingMode::INDEXED_X, { { 0xA4 },          1 } },
-                        { Assembler_AddressingMode::INDEXED_Y, { { 0x18, 0xA4 },    1 } },
+                        { Assembler_AddressingMode::IMMEDIATE, { { 0x84 },          1, 2 } },
+                        { Assembler_AddressingMode::DIRECT,    { { 0x94 },          1, 3 } },
+                        { Assembler_AddressingMode::EXTENDED,  { { 0xB4 },          2, 4 } },
+                        { Assembler_AddressingMode::INDEXED_X, { { 0xA4 },          1, 4 } },
+                        { Assembler_AddressingMode::INDEXED_Y, { { 0x18, 0xA4 },    1, 5 } },
                 }
         ),
         Instruction::Create (
                 "ANDB",
                 "AND B with Memory",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE, { { 0xC4 },          1 } },
-                        { Assembler_AddressingMode::DIRECT,    { { 0xD4 },          1 } },
-                        { Assembler_AddressingMode::EXTENDED,  { { 0xF4 },          2 } },
-                        { Assembler_AddressingMode::INDEXED_X, { { 0xE4 },          1 } },
-                        { Assembler_AddressingMode::INDEXED_Y, { { 0x18, 0xE4 },    1 } },
+                        { Assembler_AddressingMode::IMMEDIATE, { { 0xC4 },          1, 2 } },
+                        { Assembler_AddressingMode::DIRECT,    { { 0xD4 },          1, 3 } },
+                        { Assembler_AddressingMode::EXTENDED,  { { 0xF4 },          2, 4 } },
+                        { Assembler_AddressingMode::INDEXED_X, { { 0xE4 },          1, 4 } },
+                        { Assembler_AddressingMode::INDEXED_Y, { { 0x18, 0xE4 },    1, 5 } },
                 }
         ),
         Instruction::Create (
                 "ASL",
                 "Arithmetic Shift Left",
                 {
-                        { Assembler_AddressingMode::EXTENDED,   { { 0x78 },          2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { { 0x68 },          1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { { 0x18, 0x68 },    1 } },
+                        { Assembler_AddressingMode::EXTENDED,   { { 0x78 },          2, 6 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { { 0x68 },          1, 6 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { { 0x18, 0x68 },    1, 7 } },
                 }
         ),
         Instruction::Create(
                 "ASLA",
                 "Arithmetic Shift Left A",
                 {
-                        { Assembler_AddressingMode::INHERENT, { {0x48}, 0 } }
+                        { Assembler_AddressingMode::INHERENT, { {0x48}, 0, 2 } }
                 }
         ),
         Instruction::Create(
                 "ASLB",
                 "Arithmetic Shift Left B",
                 {
-                        { Assembler_AddressingMode::INHERENT, { {0x58}, 0 } }
+                        { Assembler_AddressingMode::INHERENT, { {0x58}, 0, 2 } }
                 }
         ),
         Instruction::Create(
                 "ASLD",
                 "Arithmetic Shift Left D",
                 {
-                        { Assembler_AddressingMode::INHERENT, { {0x05}, 0 } }
+                        { Assembler_AddressingMode::INHERENT, { {0x05}, 0, 3 } }
                 }
         ),
         Instruction::Create(
             "ASR",
             "Arithmetic Shift Right",
             {
-                { Assembler_AddressingMode::EXTENDED,   { { 0x77 },         2 } },
-                { Assembler_AddressingMode::INDEXED_X,  { { 0x67 },         1 } },
-                { Assembler_AddressingMode::INDEXED_Y,  { { 0x18, 0x67 },   1 } }
+                { Assembler_AddressingMode::EXTENDED,   { { 0x77 },         2, 6 } },
+                { Assembler_AddressingMode::INDEXED_X,  { { 0x67 },         1, 6 } },
+                { Assembler_AddressingMode::INDEXED_Y,  { { 0x18, 0x67 },   1, 7 } }
             }
         ),
         Instruction::Create(
                 "ASRA",
                 "Arithmetic Shift Right A",
                 {
-                        { Assembler_AddressingMode::INHERENT, { {0x47}, 0 } }
+                        { Assembler_AddressingMode::INHERENT, { {0x47}, 0, 2 } }
                 }
         ),
         Instruction::Create(
                 "ASRB",
                 "Arithmetic Shift Right B",
                 {
-                        { Assembler_AddressingMode::INHERENT, { {0x57}, 0 } }
+                        { Assembler_AddressingMode::INHERENT, { {0x57}, 0, 2 } }
                 }
         ),
         Instruction::Create(
                 "BCC",
                 "Branch if Carry Clear",
                 {
-                        { Assembler_AddressingMode::RELATIVE, { {0x24}, 1 } }
+                        { Assembler_AddressingMode::RELATIVE, { {0x24}, 1, 3 } }
                 }
         ),
         Instruction::Create(
                 "BCLR",
                 "Clear Bit(s)",
                 {
-                        { Assembler_AddressingMode::DIRECT,     { {0x15}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0x1D}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x1D}, 2 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0x15}, 2, 6 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0x1D}, 2, 7 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x1D}, 2, 8 } },
                 }
         ),
         Instruction::Create(
                 "BCS",
                 "Branch if Carry Set",
                 {
-                        { Assembler_AddressingMode::RELATIVE, { {0x25}, 1 } }
+                        { Assembler_AddressingMode::RELATIVE, { {0x25}, 1, 3 } }
                 }
         ),
         Instruction::Create(
                 "BEQ",
                 "Branch If Equal",
                 {
-                        { Assembler_AddressingMode::RELATIVE, { {0x27}, 1 } }
+                        { Assembler_AddressingMode::RELATIVE, { {0x27}, 1, 3 } }
                 }
         ),
         Instruction::Create(
                 "BGE",
                 "Branch If Greater Than or Equal (Signed)",
                 {
-                        { Assembler_AddressingMode::RELATIVE, { {0x2C}, 1 } }
+                        { Assembler_AddressingMode::RELATIVE, { {0x2C}, 1, 3 } }
                 }
         ),
         Instruction::Create(
                 "BGT",
                 "Branch If Greater Than (Signed)",
                 {
-                        { Assembler_AddressingMode::RELATIVE, { {0x2E}, 1 } }
+                        { Assembler_AddressingMode::RELATIVE, { {0x2E}, 1, 3 } }
                 }
         ),
         Instruction::Create(
                 "BHI",
                 "Branch if Higher (Unsigned)",
                 {
-                        { Assembler_AddressingMode::RELATIVE, { {0x22}, 1 } }
+                        { Assembler_AddressingMode::RELATIVE, { {0x22}, 1, 3 } }
                 }
         ),
         Instruction::Create(
                 "BHS",
                 "Branch if Higher or Same (Unsigned)",
                 {
-                        { Assembler_AddressingMode::RELATIVE, { {0x24}, 1 } }
+                        { Assembler_AddressingMode::RELATIVE, { {0x24}, 1, 3 } }
                 }
         ),
         Instruction::Create(
                 "BITA",
                 "Bit(s) Test A with Memory",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE,  { {0x85}, 1 } },
-                        { Assembler_AddressingMode::DIRECT,     { {0x95}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0xB5}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0xA5}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xA5}, 1 } },
+                        { Assembler_AddressingMode::IMMEDIATE,  { {0x85}, 1, 2 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0x95}, 1, 3 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0xB5}, 2, 4 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0xA5}, 1, 4 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xA5}, 1, 5 } },
                 }
         ),
         Instruction::Create(
                 "BITB",
                 "Bit(s) Test B with Memory",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE,  { {0xC5}, 1 } },
-                        { Assembler_AddressingMode::DIRECT,     { {0xD5}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0xF5}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0xE5}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xE5}, 1 } },
+                        { Assembler_AddressingMode::IMMEDIATE,  { {0xC5}, 1, 2 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0xD5}, 1, 3 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0xF5}, 2, 4 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0xE5}, 1, 4 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xE5}, 1, 5 } },
                 }
         ),
         Instruction::Create(
                 "BLE",
                 "Branch if Less Than or Equal (Signed)",
                 {
-                        { Assembler_AddressingMode::RELATIVE, { {0x2F}, 1 } }
+                        { Assembler_AddressingMode::RELATIVE, { {0x2F}, 1, 3 } }
                 }
         ),
         Instruction::Create(
                 "BLO",
                 "Branch if Lower (Unsigned)",
                 {
-                        { Assembler_AddressingMode::RELATIVE, { {0x25}, 1 } }
+                        { Assembler_AddressingMode::RELATIVE, { {0x25}, 1, 3 } }
                 }
         ),
         Instruction::Create(
                 "BLS",
                 "Branch if Lower or Same (Unsigned)",
                 {
-                        { Assembler_AddressingMode::RELATIVE, { {0x23}, 1 } }
+                        { Assembler_AddressingMode::RELATIVE, { {0x23}, 1, 3 } }
                 }
         ),
         Instruction::Create(
                 "BLT",
                 "Branch if Less Than (Signed)",
                 {
-                        { Assembler_AddressingMode::RELATIVE, { {0x2D}, 1 } }
+                        { Assembler_AddressingMode::RELATIVE, { {0x2D}, 1, 3 } }
                 }
         ),
         Instruction::Create(
                 "BMI",
                 "Branch if Minus",
                 {
-                        { Assembler_AddressingMode::RELATIVE, { {0x2B}, 1 } }
+                        { Assembler_AddressingMode::RELATIVE, { {0x2B}, 1, 3 } }
                 }
         ),
         Instruction::Create(
                 "BNE",
                 "Branch if Not Equal",
                 {
-                        { Assembler_AddressingMode::RELATIVE, { {0x2B}, 1 } }
+                        { Assembler_AddressingMode::RELATIVE, { {0x26}, 1, 3 } }
                 }
         ),
         Instruction::Create(
                 "BPL",
                 "Branch if Plus",
                 {
-                        { Assembler_AddressingMode::RELATIVE, { {0x2A}, 1 } }
+                        { Assembler_AddressingMode::RELATIVE, { {0x2A}, 1, 3 } }
                 }
         ),
         Instruction::Create(
                 "BRA",
                 "Branch Always",
                 {
-                        { Assembler_AddressingMode::RELATIVE, { {0x20}, 1 } }
+                        { Assembler_AddressingMode::RELATIVE, { {0x20}, 1, 3 } }
                 }
         ),
         Instruction::Create(
                 "BRCLR",
                 "Branch if Bit(s) Clear",
                 {
-                        { Assembler_AddressingMode::DIRECT,     { {0x13}, 3 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0x1F}, 3 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x1F}, 3 } }
+                        { Assembler_AddressingMode::DIRECT,     { {0x13}, 3, 6 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0x1F}, 3, 7 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x1F}, 3, 8 } }
                 }
         ),
         Instruction::Create(
                 "BRN",
                 "Branch Never", // NOTE(alex): Isn't this the exact same as NOP?
                 {
-                        { Assembler_AddressingMode::RELATIVE, { {0x21}, 1 } }
+                        { Assembler_AddressingMode::RELATIVE, { {0x21}, 1, 3 } }
                 }
         ),
         Instruction::Create(
                 "BRSET",
                 "Branch if Bit(s) Set",
                 {
-                        { Assembler_AddressingMode::DIRECT,     { {0x12}, 3 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0x1E}, 3 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x1E}, 3 } }
+                        { Assembler_AddressingMode::DIRECT,     { {0x12}, 3, 6 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0x1E}, 3, 7 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x1E}, 3, 8 } }
                 }
         ),
         Instruction::Create(
                 "BSET",
                 "Set Bit(s)",
                 {
-                        { Assembler_AddressingMode::DIRECT,     { {0x14}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0x1C}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x1C}, 2 } }
+                        { Assembler_AddressingMode::DIRECT,     { {0x14}, 2, 6 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0x1C}, 2, 7 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x1C}, 2, 8 } }
                 }
         ),
         Instruction::Create(
                 "BSR",
                 "Branch to Subroutine",
                 {
-                        { Assembler_AddressingMode::RELATIVE, { {0x8D}, 1 } }
+                        { Assembler_AddressingMode::RELATIVE, { {0x8D}, 1, 6 } }
                 }
         ),
         Instruction::Create(
                 "BVC",
                 "Branch if Overflow Clear",
                 {
-                        { Assembler_AddressingMode::RELATIVE, { {0x28}, 1 } }
+                        { Assembler_AddressingMode::RELATIVE, { {0x28}, 1, 3 } }
                 }
         ),
         Instruction::Create(
                 "BVS",
                 "Branch if Overflow Set",
                 {
-                        { Assembler_AddressingMode::RELATIVE, { {0x29}, 1 } }
+                        { Assembler_AddressingMode::RELATIVE, { {0x29}, 1, 3 } }
                 }
         ),
         Instruction::Create(
                 "CBA",
                 "Compare A to B",
                 {
-                        { Assembler_AddressingMode::INHERENT, { {0x11}, 0 } }
+                        { Assembler_AddressingMode::INHERENT, { {0x11}, 0, 2 } }
                 }
         ),
         Instruction::Create(
                 "CLC",
                 "Clear Carry Bit",
                 {
-                        { Assembler_AddressingMode::INHERENT, { {0x0C}, 0 } }
+                        { Assembler_AddressingMode::INHERENT, { {0x0C}, 0, 2 } }
                 }
         ),
         Instruction::Create(
                 "CLI",
                 "Clear Interrupt Mask",
                 {
-                        { Assembler_AddressingMode::INHERENT, { {0x0E}, 0 } }
+                        { Assembler_AddressingMode::INHERENT, { {0x0E}, 0, 2 } }
                 }
         ),
         Instruction::Create(
                 "CLR",
                 "Clear Memory Byte",
                 {
-                        { Assembler_AddressingMode::EXTENDED,   { {0x7F}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0x6F}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x6F}, 2 } }
+                        { Assembler_AddressingMode::EXTENDED,   { {0x7F}, 2, 6 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0x6F}, 1, 6 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x6F}, 1, 7 } }
                 }
         ),
         Instruction::Create(
                 "CLRA",
                 "Clear Accumulator A",
                 {
-                        { Assembler_AddressingMode::INHERENT, { {0x4F}, 0 } }
+                        { Assembler_AddressingMode::INHERENT, { {0x4F}, 0, 2 } }
                 }
         ),
         Instruction::Create(
                 "CLRB",
                 "Clear Accumulator B",
                 {
-                        { Assembler_AddressingMode::INHERENT, { {0x5F}, 0 } }
+                        { Assembler_AddressingMode::INHERENT, { {0x5F}, 0, 2 } }
                 }
         ),
         Instruction::Create(
                 "CLV",
                 "Clear Accumulator B",
                 {
-                        { Assembler_AddressingMode::INHERENT, { {0x0A}, 0 } }
+                        { Assembler_AddressingMode::INHERENT, { {0x0A}, 0, 2 } }
                 }
         ),
         Instruction::Create(
                 "CMPA",
                 "Compare A to Memory",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE,  { {0x81}, 1 } },
-                        { Assembler_AddressingMode::DIRECT,     { {0x91}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0xB1}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0xA1}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xA1}, 1 } }
+                        { Assembler_AddressingMode::IMMEDIATE,  { {0x81}, 1, 2 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0x91}, 1, 3 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0xB1}, 2, 4 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0xA1}, 1, 4 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xA1}, 1, 5 } }
                 }
         ),
         Instruction::Create(
                 "CMPB",
                 "Compare B to Memory",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE,  { {0xC1}, 1 } },
-                        { Assembler_AddressingMode::DIRECT,     { {0xD1}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0xF1}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0xE1}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xE1}, 1 } }
+                        { Assembler_AddressingMode::IMMEDIATE,  { {0xC1}, 1, 2 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0xD1}, 1, 3 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0xF1}, 2, 4 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0xE1}, 1, 4 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xE1}, 1, 5 } }
                 }
         ),
         Instruction::Create(
                 "COM",
                 "1's Complement Memory Byte",
                 {
-                        { Assembler_AddressingMode::EXTENDED,   { {0x73}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0x63}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x63}, 1 } }
+                        { Assembler_AddressingMode::EXTENDED,   { {0x73}, 2, 6 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0x63}, 1, 6 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x63}, 1, 7 } }
                 }
         ),
         Instruction::Create(
                 "COMA",
                 "1's Complement A",
                 {
-                        { Assembler_AddressingMode::INHERENT, { {0x43}, 0 } }
+                        { Assembler_AddressingMode::INHERENT, { {0x43}, 0, 2 } }
                 }
         ),
         Instruction::Create(
                 "COMB",
                 "1's Complement B",
                 {
-                        { Assembler_AddressingMode::INHERENT, { {0x53}, 0 } }
+                        { Assembler_AddressingMode::INHERENT, { {0x53}, 0, 2 } }
                 }
         ),
         Instruction::Create(
                 "CPD",
                 "Compare D to Memory 16-Bit",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE,  { {0x1A, 0x83}, 2 } },
-                        { Assembler_AddressingMode::DIRECT,     { {0x1A, 0x93}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0x1A, 0xB3}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0x1A, 0xA3}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0xCD, 0xA3}, 1 } }
+                        { Assembler_AddressingMode::IMMEDIATE,  { {0x1A, 0x83}, 2, 5 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0x1A, 0x93}, 1, 6 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0x1A, 0xB3}, 2, 7 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0x1A, 0xA3}, 1, 7 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0xCD, 0xA3}, 1, 7 } }
                 }
         ),
         Instruction::Create(
                 "CPX",
                 "Compare X to Memory 16-Bit",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE,  { {0x8C}, 2 } },
-                        { Assembler_AddressingMode::DIRECT,     { {0x9C}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0xBC}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0xAC}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0xCD, 0xAC}, 1 } }
+                        { Assembler_AddressingMode::IMMEDIATE,  { {0x8C}, 2, 4 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0x9C}, 1, 5 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0xBC}, 2, 6 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0xAC}, 1, 6 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0xCD, 0xAC}, 1, 7 } }
                 }
         ),
         Instruction::Create(
                 "CPY",
                 "Compare Y to Memory 16-Bit",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE,  { {0x18, 0x8C}, 2 } },
-                        { Assembler_AddressingMode::DIRECT,     { {0x18, 0x9C}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0x18, 0xBC}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0x1A, 0xAC}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xAC}, 1 } }
+                        { Assembler_AddressingMode::IMMEDIATE,  { {0x18, 0x8C}, 2, 5 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0x18, 0x9C}, 1, 6 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0x18, 0xBC}, 2, 7 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0x1A, 0xAC}, 1, 7 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xAC}, 1, 7 } }
                 }
         ),
         Instruction::Create(
                 "DAA",
                 "Decimal Adjust A",
                 {
-                        { Assembler_AddressingMode::INHERENT,  { {0x19}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,  { {0x19}, 0, 2 } },
                 }
         ),
         Instruction::Create(
                 "DEC",
                 "Decrement Memory Byte",
                 {
-                        { Assembler_AddressingMode::EXTENDED,   { {0x7A}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0x6A}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x6A}, 2 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0x7A}, 2, 6 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0x6A}, 1, 6 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x6A}, 1, 7 } },
                 }
         ),
         Instruction::Create(
                 "DECA",
                 "Decrement Accumulator A",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x4A}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x4A}, 0, 2 } },
                 }
         ),
         Instruction::Create(
                 "DECB",
                 "Decrement Accumulator B",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x5A}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x5A}, 0, 2 } },
                 }
         ),
         Instruction::Create(
                 "DES",
                 "Decrement Stack Pointer",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x34}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x34}, 0, 3 } },
                 }
         ),
         Instruction::Create(
                 "DEX",
                 "Decrement Index Register X",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x09}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x09}, 0, 3 } },
                 }
         ),
         Instruction::Create(
                 "DEY",
                 "Decrement Index Register Y",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x18, 0x09}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x18, 0x09}, 0, 4 } },
                 }
         ),
         Instruction::Create(
                 "EORA",
                 "Exclusive OR A with Memory",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE,  { {0x88}, 1 } },
-                        { Assembler_AddressingMode::DIRECT,     { {0x98}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0xB8}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0xA8}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xA8}, 1 } }
+                        { Assembler_AddressingMode::IMMEDIATE,  { {0x88}, 1, 2 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0x98}, 1, 3 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0xB8}, 2, 4 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0xA8}, 1, 4 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xA8}, 1, 5 } }
                 }
         ),
         Instruction::Create(
                 "EORB",
                 "Exclusive OR B with Memory",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE,  { {0xC8}, 1 } },
-                        { Assembler_AddressingMode::DIRECT,     { {0xD8}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0xF8}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0xE8}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xE8}, 1 } }
+                        { Assembler_AddressingMode::IMMEDIATE,  { {0xC8}, 1, 2 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0xD8}, 1, 3 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0xF8}, 2, 4 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0xE8}, 1, 4 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xE8}, 1, 5 } }
                 }
         ),
         Instruction::Create(
                 "FDIV",
                 "Fractional Divide 16 by 16 (Unsigned)",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x03}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x03}, 0, 41 } },
                 }
         ),
         Instruction::Create(
                 "IDIV",
                 "Integer Divide by 16 by 16 (Unsigned)",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x02}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x02}, 0, 41 } },
                 }
         ),
         Instruction::Create(
                 "INC",
                 "Increase Memory Byte",
                 {
-                        { Assembler_AddressingMode::EXTENDED,   { {0x7C}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0x6C}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x6C}, 1 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0x7C}, 2, 6 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0x6C}, 1, 6 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x6C}, 1, 7 } },
                 }
         ),
         Instruction::Create(
                 "INCA",
                 "Increment Accumulator A",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x4C}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x4C}, 0, 2 } },
                 }
         ),
         Instruction::Create(
                 "INCB",
                 "Increment Accumulator B",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x5C}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x5C}, 0, 2 } },
                 }
         ),
         Instruction::Create(
                 "INS",
                 "Increment Stack Pointer",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x31}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x31}, 0, 3 } },
                 }
         ),
         Instruction::Create(
                 "INX",
                 "Increment Index Register X",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x08}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x08}, 0, 3 } },
                 }
         ),
         Instruction::Create(
                 "INY",
                 "Increment Index Register Y",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x18, 0x08}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x18, 0x08}, 0, 4 } },
                 }
         ),
         Instruction::Create(
                 "JMP",
                 "Jump",
                 {
-                        { Assembler_AddressingMode::EXTENDED,   { {0x7E}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0x6E}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x6E}, 1 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0x7E}, 2, 3 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0x6E}, 1, 3 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x6E}, 1, 4 } },
                 }
         ),
         Instruction::Create(
                 "JSR",
                 "Jump to Subroutine",
                 {
-                        { Assembler_AddressingMode::DIRECT,     { {0x9D}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0x8D}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0xAD}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xAD}, 1 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0x9D}, 1, 5 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0xBD}, 2, 6 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0xAD}, 1, 6 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xAD}, 1, 7 } },
                 }
         ),
         Instruction::Create(
                 "LDAA",
                 "Load Accumulator A",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE,  { {0x86}, 1 } },
-                        { Assembler_AddressingMode::DIRECT,     { {0x96}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0xB6}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0xA6}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xA6}, 1 } },
+                        { Assembler_AddressingMode::IMMEDIATE,  { {0x86}, 1, 2 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0x96}, 1, 3 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0xB6}, 2, 4 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0xA6}, 1, 4 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xA6}, 1, 5 } },
                 }
         ),
         Instruction::Create(
                 "LDAB",
                 "Load Accumulator B",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE,  { {0xC6}, 1 } },
-                        { Assembler_AddressingMode::DIRECT,     { {0xD6}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0xF6}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0xE6}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xE6}, 1 } },
+                        { Assembler_AddressingMode::IMMEDIATE,  { {0xC6}, 1, 2 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0xD6}, 1, 3 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0xF6}, 2, 4 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0xE6}, 1, 4 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xE6}, 1, 5 } },
                 }
         ),
         Instruction::Create(
                 "LDD",
                 "Load Accumulator D",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE,  { {0xCC}, 2 } },
-                        { Assembler_AddressingMode::DIRECT,     { {0xDC}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0xFC}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0xEC}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xEC}, 1 } },
+                        { Assembler_AddressingMode::IMMEDIATE,  { {0xCC}, 2, 3 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0xDC}, 1, 4 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0xFC}, 2, 5 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0xEC}, 1, 5 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xEC}, 1, 6 } },
                 }
         ),
         Instruction::Create(
                 "LDS",
                 "Load Stack Pointer",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE,  { {0x8E}, 2 } },
-                        { Assembler_AddressingMode::DIRECT,     { {0x9E}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0xBE}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0xAE}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xAE}, 1 } },
+                        { Assembler_AddressingMode::IMMEDIATE,  { {0x8E}, 2, 3 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0x9E}, 1, 4 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0xBE}, 2, 5 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0xAE}, 1, 5 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xAE}, 1, 6 } },
                 }
         ),
         Instruction::Create(
                 "LDX",
                 "Load Index Register X",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE,  { {0xCE}, 2 } },
-                        { Assembler_AddressingMode::DIRECT,     { {0xDE}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0xFE}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0xEE}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xEE}, 1 } },
+                        { Assembler_AddressingMode::IMMEDIATE,  { {0xCE}, 2, 3 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0xDE}, 1, 4 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0xFE}, 2, 5 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0xEE}, 1, 5 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0xCD, 0xEE}, 1, 6 } },
                 }
         ),
         Instruction::Create(
                 "LDY",
                 "Load Index Register Y",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE,  { {0x18, 0xCE}, 2 } },
-                        { Assembler_AddressingMode::DIRECT,     { {0x18, 0xDE}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0x18, 0xFE}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0x1A, 0xEE}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xEE}, 1 } },
+                        { Assembler_AddressingMode::IMMEDIATE,  { {0x18, 0xCE}, 2, 4 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0x18, 0xDE}, 1, 5 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0x18, 0xFE}, 2, 6 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0x1A, 0xEE}, 1, 6 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xEE}, 1, 6 } },
                 }
         ),
         Instruction::Create(
                 "LSL",
                 "Logical Shift Left",
                 {
-                        { Assembler_AddressingMode::EXTENDED,   { {0x78}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0x68}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x68}, 1 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0x78}, 2, 6 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0x68}, 1, 6 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x68}, 1, 7 } },
                 }
         ),
         Instruction::Create(
                 "LSLA",
                 "Logical Shift Left A",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x48}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x48}, 0, 2 } },
                 }
         ),
         Instruction::Create(
                 "LSLB",
                 "Logical Shift Left B",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x58}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x58}, 0, 2 } },
                 }
         ),
         Instruction::Create(
                 "LSLD",
                 "Logical Shift Left Double",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x05}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x05}, 0, 3 } },
                 }
         ),
         Instruction::Create(
                 "LSR",
                 "Logical Shift Right",
                 {
-                        { Assembler_AddressingMode::EXTENDED,   { {0x74}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0x64}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x64}, 1 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0x74}, 2, 6 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0x64}, 1, 6 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x64}, 1, 7 } },
                 }
         ),
         Instruction::Create(
                 "LSRA",
                 "Logical Shift Right A",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x44}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x44}, 0, 2 } },
                 }
         ),
         Instruction::Create(
                 "LSRB",
                 "Logical Shift Right B",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x54}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x54}, 0, 2 } },
                 }
         ),
         Instruction::Create(
                 "LSRD",
                 "Logical Shift Right Double",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x04}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x04}, 0, 3 } },
                 }
         ),
         Instruction::Create(
                 "MUL",
                 "Multiply 8 by 8",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x3D}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x3D}, 0, 10 } },
                 }
         ),
         Instruction::Create(
                 "NEG",
                 "2's Complement Memory Byte",
                 {
-                        { Assembler_AddressingMode::EXTENDED,   { {0x70}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0x60}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x60}, 1 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0x70}, 2, 6 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0x60}, 1, 6 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x60}, 1, 7 } },
                 }
         ),
         Instruction::Create(
                 "NEGA",
                 "2's Complement A",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x40}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x40}, 0, 2 } },
                 }
         ),
         Instruction::Create(
                 "NEGB",
                 "2's Complement B",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x50}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x50}, 0, 2 } },
                 }
         ),
         Instruction::Create(
                 "NOP",
                 "No Operation",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x01}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x01}, 0, 2 } },
                 }
         ),
         Instruction::Create(
                 "ORAA",
                 "OR Accumulator A (Inclusive)",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE,  { {0x8A}, 1 } },
-                        { Assembler_AddressingMode::DIRECT,     { {0x9A}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0xBA}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0xAA}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xAA}, 1 } },
+                        { Assembler_AddressingMode::IMMEDIATE,  { {0x8A}, 1, 2 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0x9A}, 1, 3 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0xBA}, 2, 4 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0xAA}, 1, 4 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xAA}, 1, 5 } },
                 }
         ),
         Instruction::Create(
                 "ORAB",
                 "OR Accumulator B (Inclusive)",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE,  { {0xCA}, 1 } },
-                        { Assembler_AddressingMode::DIRECT,     { {0xDA}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0xFA}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0xEA}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xEA}, 1 } },
+                        { Assembler_AddressingMode::IMMEDIATE,  { {0xCA}, 1, 2 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0xDA}, 1, 3 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0xFA}, 2, 4 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0xEA}, 1, 4 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xEA}, 1, 5 } },
                 }
         ),
         Instruction::Create(
                 "PSHA",
                 "Push A onto Stack",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x36}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x36}, 0, 3 } },
                 }
         ),
         Instruction::Create(
                 "PSHB",
                 "Push B onto Stack",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x37}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x37}, 0, 3 } },
                 }
         ),
         Instruction::Create(
                 "PSHX",
                 "Push X onto Stack",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x3C}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x3C}, 0, 4 } },
                 }
         ),
         Instruction::Create(
                 "PSHY",
                 "Push Y onto Stack",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x18, 0x3C}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x18, 0x3C}, 0, 5 } },
                 }
         ),
         Instruction::Create(
                 "PULA",
                 "Pull A onto Stack",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x32}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x32}, 0, 4 } },
                 }
         ),
         Instruction::Create(
                 "PULB",
                 "Pull B onto Stack",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x33}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x33}, 0, 4 } },
                 }
         ),
         Instruction::Create(
                 "PULX",
                 "Pull X onto Stack",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x38}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x38}, 0, 5 } },
                 }
         ),
         Instruction::Create(
                 "PULY",
                 "Pull Y onto Stack",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x18, 0x38}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x18, 0x38}, 0, 6 } },
                 }
         ),
         Instruction::Create(
                 "ROL",
                 "Rotate Left",
                 {
-                        { Assembler_AddressingMode::EXTENDED,   { {0x79}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0x69}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x69}, 1 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0x79}, 2, 6 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0x69}, 1, 6 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x69}, 1, 7 } },
                 }
         ),
         Instruction::Create(
                 "ROLA",
                 "Rotate Left A",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x49}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x49}, 0, 2 } },
                 }
         ),
         Instruction::Create(
                 "ROLB",
                 "Rotate Left B",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x59}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x59}, 0, 2 } },
                 }
         ),
         Instruction::Create(
                 "ROR",
                 "Rotate Right",
                 {
-                        { Assembler_AddressingMode::EXTENDED,   { {0x76}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0x66}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x66}, 1 } }
+                        { Assembler_AddressingMode::EXTENDED,   { {0x76}, 2, 6 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0x66}, 1, 6 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x66}, 1, 7 } }
                 }
         ),
         Instruction::Create(
                 "RORA",
                 "Rotate Right A",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x46}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x46}, 0, 2 } },
                 }
         ),
         Instruction::Create(
                 "RORB",
                 "Rotate Right B",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x56}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x56}, 0, 2 } },
                 }
         ),
         Instruction::Create(
                 "RTI",
                 "Return from Interrupt",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x3B}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x3B}, 0, 12 } },
                 }
         ),
         Instruction::Create(
                 "RTS",
                 "Return from Subroutine",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x39}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x39}, 0, 5 } },
                 }
         ),
         Instruction::Create(
                 "SBA",
                 "Subtract B from A",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x10}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x10}, 0, 2 } },
                 }
         ),
         Instruction::Create(
                 "SBCA",
                 "Subtract with Carry from A",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE,  { {0x82}, 1 } },
-                        { Assembler_AddressingMode::DIRECT,     { {0x92}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0xB2}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0xA2}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xA2}, 1 } },
+                        { Assembler_AddressingMode::IMMEDIATE,  { {0x82}, 1, 2 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0x92}, 1, 3 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0xB2}, 2, 4 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0xA2}, 1, 4 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xA2}, 1, 5 } },
                 }
         ),
         Instruction::Create(
                 "SBCB",
                 "Subtract with Carry from B",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE,  { {0xC2}, 1 } },
-                        { Assembler_AddressingMode::DIRECT,     { {0xD2}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0xF2}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0xE2}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xE2}, 1 } },
+                        { Assembler_AddressingMode::IMMEDIATE,  { {0xC2}, 1, 2 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0xD2}, 1, 3 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0xF2}, 2, 4 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0xE2}, 1, 4 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xE2}, 1, 5 } },
                 }
         ),
         Instruction::Create(
                 "SEC",
                 "Set Carry",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x0D}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x0D}, 0, 2 } },
                 }
         ),
         Instruction::Create(
                 "SEI",
                 "Set Interrupt Mask",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x0F}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x0F}, 0, 2 } },
                 }
         ),
         Instruction::Create(
                 "SEV",
                 "Set Overflow Flag",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x0B}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x0B}, 0, 2 } },
                 }
         ),
         Instruction::Create(
                 "STAA",
                 "Store Accumulator A",
                 {
-                        { Assembler_AddressingMode::DIRECT,     { {0x97}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0xB7}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0xA7}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xA7}, 1 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0x97}, 1, 3 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0xB7}, 2, 4 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0xA7}, 1, 4 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xA7}, 1, 5 } },
                 }
         ),
         Instruction::Create(
                 "STAB",
                 "Store Accumulator B",
                 {
-                        { Assembler_AddressingMode::DIRECT,     { {0xD7}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0xF7}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0xE7}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xE7}, 1 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0xD7}, 1, 3 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0xF7}, 2, 4 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0xE7}, 1, 4 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xE7}, 1, 5 } },
                 }
         ),
         Instruction::Create(
                 "STD",
                 "Store Accumulator D",
                 {
-                        { Assembler_AddressingMode::DIRECT,     { {0xDD}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0xFD}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0xED}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xED}, 1 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0xDD}, 1, 4 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0xFD}, 2, 5 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0xED}, 1, 5 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xED}, 1, 6 } },
                 }
         ),
         Instruction::Create(
                 "STOP",
                 "Stop Internal Clocks",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0xCF}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0xCF}, 0, 2 } },
                 }
         ),
         Instruction::Create(
                 "STS",
                 "Store Stack Pointer",
                 {
-                        { Assembler_AddressingMode::DIRECT,     { {0x9F}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0xBF}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0xAF}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xAF}, 1 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0x9F}, 1, 4 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0xBF}, 2, 5 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0xAF}, 1, 5 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xAF}, 1, 6 } },
                 }
         ),
         Instruction::Create(
                 "STX",
                 "Store Index Register X",
                 {
-                        { Assembler_AddressingMode::DIRECT,     { {0xDF}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0xFF}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0xEF}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xEF}, 1 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0xDF}, 1, 4 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0xFF}, 2, 5 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0xEF}, 1, 5 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0xCD, 0xEF}, 1, 6 } },
                 }
         ),
         Instruction::Create(
                 "STY",
                 "Store Index Register Y",
                 {
-                        { Assembler_AddressingMode::DIRECT,     { {0x18, 0x9F}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0x18, 0xBF}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0x1A, 0xAF}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xAF}, 1 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0x18, 0xDF}, 1, 5 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0x18, 0xFF}, 2, 6 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0x1A, 0xEF}, 1, 6 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xEF}, 1, 6 } },
                 }
         ),
         Instruction::Create(
                 "SUBA",
                 "Subtract Memory from A",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE,  { {0x80}, 1 } },
-                        { Assembler_AddressingMode::DIRECT,     { {0x90}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0xB0}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0xA0}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xA0}, 1 } },
+                        { Assembler_AddressingMode::IMMEDIATE,  { {0x80}, 1, 2 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0x90}, 1, 3 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0xB0}, 2, 4 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0xA0}, 1, 4 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xA0}, 1, 5 } },
                 }
         ),
         Instruction::Create(
                 "SUBB",
                 "Subtract Memory from B",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE,  { {0xC0}, 1 } },
-                        { Assembler_AddressingMode::DIRECT,     { {0xD0}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0xF0}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0xE0}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xE0}, 1 } },
+                        { Assembler_AddressingMode::IMMEDIATE,  { {0xC0}, 1, 2 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0xD0}, 1, 3 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0xF0}, 2, 4 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0xE0}, 1, 4 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xE0}, 1, 5 } },
                 }
         ),
         Instruction::Create(
                 "SUBD",
                 "Subtract Memory from D",
                 {
-                        { Assembler_AddressingMode::IMMEDIATE,  { {0x83}, 2 } },
-                        { Assembler_AddressingMode::DIRECT,     { {0x93}, 1 } },
-                        { Assembler_AddressingMode::EXTENDED,   { {0xB3}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0xA3}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xA3}, 1 } },
+                        { Assembler_AddressingMode::IMMEDIATE,  { {0x83}, 2, 4 } },
+                        { Assembler_AddressingMode::DIRECT,     { {0x93}, 1, 5 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0xB3}, 2, 6 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0xA3}, 1, 6 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0xA3}, 1, 7 } },
                 }
         ),
         Instruction::Create(
                 "SWI",
                 "Software Interrupt",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x3F}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x3F}, 0, 14 } },
                 }
         ),
         Instruction::Create(
                 "TAB",
                 "Transfer A to B",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x16}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x16}, 0, 2 } },
                 }
         ),
         Instruction::Create(
                 "TAP",
                 "Transfer A to CC Register",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x06}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x06}, 0, 2 } },
                 }
         ),
         Instruction::Create(
                 "TBA",
                 "Transfer B to A",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x17}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x17}, 0, 2 } },
                 }
         ),
         Instruction::Create(
                 "TEST",
                 "TEST (Only in Test Modes)",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x00}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x00}, 0, 0 } },
                 }
         ),
         Instruction::Create(
                 "TPA",
                 "Transfer CC Register to A",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x07}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x07}, 0, 2 } },
                 }
         ),
         Instruction::Create(
                 "TST",
                 "Test Memory",
                 {
-                        { Assembler_AddressingMode::EXTENDED,   { {0x7D}, 2 } },
-                        { Assembler_AddressingMode::INDEXED_X,  { {0x6D}, 1 } },
-                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x6D}, 1 } },
+                        { Assembler_AddressingMode::EXTENDED,   { {0x7D}, 2, 6 } },
+                        { Assembler_AddressingMode::INDEXED_X,  { {0x6D}, 1, 6 } },
+                        { Assembler_AddressingMode::INDEXED_Y,  { {0x18, 0x6D}, 1, 7 } },
                 }
         ),
         Instruction::Create(
                 "TSTA",
                 "Test Accumulator A",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x4D}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x4D}, 0, 2 } },
                 }
         ),
         Instruction::Create(
                 "TSTB",
                 "Test Accumulator B",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x5D}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x5D}, 0, 2 } },
                 }
         ),
         Instruction::Create(
                 "TSX",
                 "Transfer Stack Pointer to X",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x30}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x30}, 0, 3 } },
                 }
         ),
         Instruction::Create(
                 "TSY",
                 "Transfer Stack Pointer to Y",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x18, 0x30}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x18, 0x30}, 0, 4 } },
                 }
         ),
         Instruction::Create(
                 "TXS",
                 "Transfer X to Stack Pointer",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x35}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x35}, 0, 3 } },
                 }
         ),
         Instruction::Create(
                 "TYS",
                 "Transfer Y to Stack Pointer",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x18, 0x35}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x18, 0x35}, 0, 4 } },
                 }
         ),
         Instruction::Create(
                 "WAI",
                 "Wait for Interrupt",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x3E}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x3E}, 0, 14 } },
                 }
         ),
         Instruction::Create(
                 "XGDX",
                 "Exchange D with X",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x8F}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x8F}, 0, 3 } },
                 }
         ),
         Instruction::Create(
                 "XGDY",
                 "Exchange D with Y",
                 {
-                        { Assembler_AddressingMode::INHERENT,   { {0x18, 0x8F}, 0 } },
+                        { Assembler_AddressingMode::INHERENT,   { {0x18, 0x8F}, 0, 4 } },
                 }
         ),
-};
+});
 
 namespace ReservedDirectives {
-    inline InstructionRef OrgInst = AllInstructions[0];
-    inline InstructionRef RmbInst = AllInstructions[1];
+    inline constexpr InstructionRef OrgInst = &AllInstructions[0];
+    inline constexpr InstructionRef RmbInst = &AllInstructions[1];
+}
+
+
+// NOTE: every mnemonic fits in 8 characters, so it packs losslessly into a single integer key that can be
+// compared in one instruction instead of a full string compare
+constexpr u64 PackMnemonic(std::string_view mnemonic) {
+    if (mnemonic.empty() || mnemonic.size() > sizeof(u64))
+        return 0;
+
+    u64 key = 0;
+    for (const char c : mnemonic)
+        key = (key << 8) | static_cast<u8>(c);
+
+    return key;
 }
 
+constexpr u32 HashMnemonicKey(u64 key, u32 seed) {
+    key ^= seed * 0x9E3779B97F4A7C15ull;
+    key ^= key >> 31;
+    key *= 0xBF58476D1CE4E5B9ull;
+    key ^= key >> 29;
+    return static_cast<u32>(key);
+}
+
+// Perfect hash over the mnemonic set (hash-and-displace): each key first hashes into a bucket, and every bucket
+// stores the seed that scatters its keys into distinct slots. A lookup is two hashes and one key compare.
+class MnemonicTable {
+public:
+    static constexpr sz_t BucketCount = 64;
+    static constexpr sz_t SlotCount = 256;
+
+    template<typename Range>
+    constexpr explicit MnemonicTable(const Range &mnemonics) {
+        std::array<u64, SlotCount> pending{};
+        sz_t count = 0;
+
+        for (const std::string_view mnemonic : mnemonics) {
+            const u64 key = PackMnemonic(mnemonic);
+
+            if (key == 0 || count == SlotCount)
+                throw std::logic_error("Mnemonic cannot be hashed");
+
+            for (sz_t i = 0; i < count; i++) {
+                if (pending[i] == key)
+                    throw std::logic_error("Duplicate mnemonic");
+            }
+
+            pending[count++] = key;
+        }
+
+        std::array<bool, BucketCount> placed{};
+
+        // NOTE: place the most crowded buckets first while the slot array is still mostly empty
+        for (sz_t round = 0; round < BucketCount; round++) {
+            sz_t bucket = BucketCount;
+            sz_t bucketSize = 0;
+
+            for (sz_t b = 0; b < BucketCount; b++) {
+                if (placed[b])
+                    continue;
+
+                sz_t size = 0;
+                for (sz_t i = 0; i < count; i++)
+                    size += BucketOf(pending[i]) == b;
+
+                if (bucket == BucketCount || size > bucketSize) {
+                    bucket = b;
+                    bucketSize = size;
+                }
+            }
+
+            placed[bucket] = true;
+            if (bucketSize == 0)
+                continue;
+
+            std::array<u16, SlotCount> members{};
+            sz_t memberCount = 0;
+            for (sz_t i = 0; i < count; i++) {
+                if (BucketOf(pending[i]) == bucket)
+                    members[memberCount++] = i;
+            }
+
+            for (u32 seed = 1;; seed++) {
+                if (seed > 0xFFFF)
+                    throw std::logic_error("Failed to build mnemonic hash");
+
+                std::array<u16, SlotCount> slots{};
+                bool collides = false;
 
-inline InstructionRef GetInstructionByMnemonic(const std::string &mnemonic) {
-    // TODO(alex): replace with hash map for faster lookup
-    auto inst = std::find_if(AllInstructions.begin(), AllInstructions.end(), [&mnemonic](const std::shared_ptr<Instruction>& instruction) {
-        return instruction->mnemonic == mnemonic;
-    });
+                for (sz_t m = 0; m < memberCount && !collides; m++) {
+                    slots[m] = SlotOf(pending[members[m]], seed);
+                    collides = keys[slots[m]] != 0;
 
-    if (inst == AllInstructions.end()) {
+                    for (sz_t n = 0; n < m && !collides; n++)
+                        collides = slots[n] == slots[m];
+                }
+
+                if (collides)
+                    continue;
+
+                seeds[bucket] = seed;
+                for (sz_t m = 0; m < memberCount; m++) {
+                    keys[slots[m]] = pending[members[m]];
+                    indices[slots[m]] = members[m];
+                }
+                break;
+            }
+        }
+    }
+
+    [[nodiscard]] constexpr std::optional<u16> Find(std::string_view mnemonic) const {
+        const u64 key = PackMnemonic(mnemonic);
+        if (key == 0)
+            return std::nullopt;
+
+        const u16 slot = SlotOf(key, seeds[BucketOf(key)]);
+        if (keys[slot] != key)
+            return std::nullopt;
+
+        return indices[slot];
+    }
+
+private:
+    static constexpr sz_t BucketOf(u64 key) {
+        return HashMnemonicKey(key, 0) % BucketCount;
+    }
+
+    static constexpr u16 SlotOf(u64 key, u32 seed) {
+        return HashMnemonicKey(key, seed) % SlotCount;
+    }
+
+    std::array<u16, BucketCount> seeds{};
+    std::array<u64, SlotCount> keys{};
+    std::array<u16, SlotCount> indices{};
+};
+
+inline constexpr MnemonicTable InstructionMnemonics = [] {
+    std::array<std::string_view, AllInstructions.size()> mnemonics{};
+
+    for (sz_t i = 0; i < AllInstructions.size(); i++)
+        mnemonics[i] = AllInstructions[i].mnemonic;
+
+    return MnemonicTable(mnemonics);
+}();
+
+inline InstructionRef GetInstructionByMnemonic(std::string_view mnemonic) {
+    const std::optional<u16> index = InstructionMnemonics.Find(mnemonic);
+
+    if (!index) {
         return nullptr;
     }
 
-    return *inst;
+    return &AllInstructions[*index];
 }
 
-class Row {
-public:
-    std::string label;
-    std::string raw;
+// NOTE: a cheap view of one row, put together from the columns of the row table on access
+struct Row {
+    std::string_view raw;
+    u32 line;
+    std::string_view label;
     InstructionRef instruction;
-    std::vector<std::string> tokens;
-
     Assembler_AddressingMode mode;
-    std::string referencedLabel;
-    std::vector<u8> operand;
-    std::vector<u8> assembled;
-    u16 offset;
+    std::string_view referencedLabel;
+    std::span<const u8> assembled;
+    u16 address;
 
     [[nodiscard]] std::string str(const size_t minWidth = 8) const {
         std::stringstream out;
         std::string bytes;
 
-        bytes.append(std::format("{:04x}: ", offset - assembled.size()));
+        bytes.append(std::format("{:04x}: ", address));
 
         for (const u8 opcode : assembled)
             bytes.append(std::format("{:02x} ", opcode));
 
-        out << std::left << std::setw(minWidth*2) << bytes << std::setw(minWidth);
-
-        for (const auto& token : tokens)
-            out << token;
+        out << std::left << std::setw(minWidth*2) << bytes << raw;
 
         return out.str();
     }
 };
 
-inline bool IsStringNumber(const std::string &s) {
-    return !s.empty() && std::all_of(s.begin(), s.end(), ::isdigit);
-}
+// Structure-of-arrays storage for assembled rows. All columns and the shared byte buffer live in the assembler's
+// arena; raw text stays a view into the source and labels are symbol IDs.
+class RowTable {
+public:
+    static constexpr u8 NoInstruction = 0xFF;
+
+    RowTable(std::pmr::memory_resource *memory, const SymbolTable &symbols)
+        : memory(memory), symbols(symbols), raw(memory), line(memory), label(memory), instruction(memory),
+          mode(memory), referencedLabel(memory), byteOffset(memory), byteCount(memory), address(memory),
+          bytes(memory) {}
+
+    [[nodiscard]] sz_t size() const { return raw.size(); }
+    [[nodiscard]] bool empty() const { return raw.empty(); }
+
+    [[nodiscard]] InstructionRef Instruction(sz_t i) const {
+        return instruction[i] == NoInstruction ? nullptr : &AllInstructions[instruction[i]];
+    }
+
+    [[nodiscard]] std::span<const u8> Assembled(sz_t i) const {
+        return { bytes.data() + byteOffset[i], byteCount[i] };
+    }
+
+    [[nodiscard]] std::span<u8> Assembled(sz_t i) {
+        return { bytes.data() + byteOffset[i], byteCount[i] };
+    }
+
+    // NOTE: address of the first byte after the row, which is where the next row starts
+    [[nodiscard]] u16 End(sz_t i) const {
+        return address[i] + byteCount[i];
+    }
+
+    [[nodiscard]] Row operator[](sz_t i) const {
+        return {
+            raw[i],
+            line[i],
+            symbols.Name(label[i]),
+            Instruction(i),
+            static_cast<Assembler_AddressingMode>(mode[i]),
+            symbols.Name(referencedLabel[i]),
+            Assembled(i),
+            address[i]
+        };
+    }
+
+    class Iterator {
+    public:
+        Iterator(const RowTable &table, sz_t index) : table(&table), index(index) {}
+
+        Row operator*() const { return (*table)[index]; }
+        Iterator &operator++() { index++; return *this; }
+        bool operator==(const Iterator &other) const { return index == other.index; }
+
+    private:
+        const RowTable *table;
+        sz_t index;
+    };
+
+    [[nodiscard]] Iterator begin() const { return { *this, 0 }; }
+    [[nodiscard]] Iterator end() const { return { *this, size() }; }
+
+    void Reserve(sz_t rows) {
+        raw.reserve(rows);
+        line.reserve(rows);
+        label.reserve(rows);
+        instruction.reserve(rows);
+        mode.reserve(rows);
+        referencedLabel.reserve(rows);
+        byteOffset.reserve(rows);
+        byteCount.reserve(rows);
+        address.reserve(rows);
+    }
+
+    void Truncate(sz_t count) {
+        raw.resize(count);
+        line.resize(count);
+        label.resize(count);
+        instruction.resize(count);
+        mode.resize(count);
+        referencedLabel.resize(count);
+        byteOffset.resize(count);
+        byteCount.resize(count);
+        address.resize(count);
+    }
+
+    // NOTE: copies the columns only; byte offsets are kept as they are, so both tables must share one byte buffer
+    void AppendRows(const RowTable &from, sz_t begin, sz_t end) {
+        raw.insert(raw.end(), from.raw.begin() + begin, from.raw.begin() + end);
+        line.insert(line.end(), from.line.begin() + begin, from.line.begin() + end);
+        label.insert(label.end(), from.label.begin() + begin, from.label.begin() + end);
+        instruction.insert(instruction.end(), from.instruction.begin() + begin, from.instruction.begin() + end);
+        mode.insert(mode.end(), from.mode.begin() + begin, from.mode.begin() + end);
+        referencedLabel.insert(referencedLabel.end(), from.referencedLabel.begin() + begin, from.referencedLabel.begin() + end);
+        byteOffset.insert(byteOffset.end(), from.byteOffset.begin() + begin, from.byteOffset.begin() + end);
+        byteCount.insert(byteCount.end(), from.byteCount.begin() + begin, from.byteCount.begin() + end);
+        address.insert(address.end(), from.address.begin() + begin, from.address.begin() + end);
+    }
+
+    // NOTE: must run before the backing arena is rewound so nothing keeps pointing into reclaimed memory
+    void Clear() {
+        raw = decltype(raw)(memory);
+        line = decltype(line)(memory);
+        label = decltype(label)(memory);
+        instruction = decltype(instruction)(memory);
+        mode = decltype(mode)(memory);
+        referencedLabel = decltype(referencedLabel)(memory);
+        byteOffset = decltype(byteOffset)(memory);
+        byteCount = decltype(byteCount)(memory);
+        address = decltype(address)(memory);
+        bytes = decltype(bytes)(memory);
+    }
+
+private:
+    std::pmr::memory_resource *memory;
+    const SymbolTable &symbols;
+
+public:
+    std::pmr::vector<std::string_view> raw;
+    std::pmr::vector<u32> line;
+    std::pmr::vector<SymbolId> label;
+    std::pmr::vector<u8> instruction;
+    std::pmr::vector<u8> mode;
+    std::pmr::vector<SymbolId> referencedLabel;
+    std::pmr::vector<u32> byteOffset;
+    std::pmr::vector<u16> byteCount;
+    std::pmr::vector<u16> address;
+
+    // NOTE: emitted bytes of every row, back to back; rows refer to their slice by offset and length
+    std::pmr::vector<u8> bytes;
+};
 
 class Assembler {
 public:
+    // NOTE: chunks fed to the assembler are copied into blocks of this size, one line at a time
+    static constexpr sz_t FeedBlockSize = 64 * 1024;
+
+    Assembler() = default;
+    Assembler(const Assembler &) = delete;
+    Assembler &operator=(const Assembler &) = delete;
+
     void Assemble(std::stringstream& str) {
-        for (std::string line; std::getline(str, line, '\n');) {
-            lines.emplace_back(AssembleSingleLine(line));
-        }
+        Assemble(str.str());
+    }
 
-        ResolveBranches();
+    // NOTE: rows keep views into the source text, so the assembler holds on to it until Reset()
+    void Assemble(std::string text) {
+        const std::string &source = sources.emplace_back(std::move(text));
+        Assemble(std::span<const char>(source));
     }
 
-    void Reset() {
-        lines.clear();
-        labelAddresses.clear();
+    // NOTE: assembles straight out of the caller's buffer without copying it, so the buffer must outlive the rows
+    void Assemble(std::span<const char> source) {
+        AssembleSource(source);
+        Layout();
+        ResolveFixups();
     }
 
-    void ResolveBranches() {
-        for (auto& row : lines) {
-            if (row.mode != Assembler_AddressingMode::RELATIVE)
-                continue;
+    void AssembleFile(const std::string &path) {
+        Assemble(mappings.emplace_back(path).Contents());
+    }
+
+    // NOTE: modules are laid out one after another in a single program, so labels may be referenced across files
+    void AssembleFiles(std::span<const std::string> paths) {
+        for (const std::string &path : paths) {
+            AssembleSource(mappings.emplace_back(path).Contents());
+        }
+
+        Layout();
+        ResolveFixups();
+    }
 
-            u16 branchOffset = 0;
+    // NOTE: incremental input for pipes; only the unfinished last line is buffered between calls, and complete lines
+    // are assembled as soon as they arrive. Call Finish() once the input is exhausted.
+    void Feed(std::span<const char> chunk) {
+        std::string_view data(chunk.data(), chunk.size());
 
-            try {
-                branchOffset = labelAddresses.at(row.referencedLabel);
-            } catch (std::out_of_range& e) {
-                throw std::runtime_error("Invalid label");
+        for (sz_t newline; (newline = data.find('\n')) != std::string_view::npos;) {
+            std::string_view text = data.substr(0, newline);
+
+            if (!pending.empty()) {
+                pending.append(text);
+                text = pending;
             }
 
-            i16 offset = branchOffset - row.offset;
+            AssembleSingleLine(Lexer::Tokenize(StoreLine(text), feedLine++));
+            pending.clear();
+            data.remove_prefix(newline + 1);
+        }
+
+        pending.append(data);
+    }
+
+    void Finish() {
+        if (!pending.empty()) {
+            AssembleSingleLine(Lexer::Tokenize(StoreLine(pending), feedLine++));
+            pending.clear();
+        }
+
+        feedLine = 1;
+        Layout();
+        ResolveFixups();
+    }
+
+    // NOTE: live editing entry point. Only the lines between the unchanged start and end of the previous text are
+    // lexed and assembled again; the rows after them are shifted rather than rebuilt, and only branches whose row or
+    // target moved are resolved again. Returns the index of the first row that may have changed.
+    sz_t Update(std::string text) {
+        if (!editable || sources.size() != 1 || Garbage() > lines.bytes.size() / 2 + FeedBlockSize) {
+            Rebuild(std::move(text));
+            return 0;
+        }
 
-            if (offset < -127 || offset > 127) {
-                throw std::runtime_error("Branch out of range");
+        try {
+            return UpdateChangedLines(std::move(text));
+        } catch (std::runtime_error &) {
+            // NOTE: rows are only left half updated if the edited lines themselves failed to assemble
+            if (!editable) {
+                Rebuild(std::string(sources.back()));
             }
 
-            row.assembled.back() = offset;
+            throw;
         }
     }
 
-    Row AssembleSingleLine(const std::string& str) {
-        Row row = {};
-        row.raw = str;
+    void Reset() {
+        lines.Clear();
+        symbols.Clear();
+        fixups = decltype(fixups)(&arena);
+        unresolved.clear();
+        arena.Rewind();
 
-        std::stringstream ss(str);
-        std::string token;
-        while (ss >> token) {
-            if (token.empty())
-                continue;
+        sources.clear();
+        mappings.clear();
+        pending.clear();
+        feedLine = 1;
+        longest = 0;
+        editable = false;
+        resolved = false;
+        liveBytes = 0;
+    }
+
+    // NOTE: one pass over the uses of symbols rather than over the rows; every use that cannot be patched is
+    // collected and reported together
+    void ResolveFixups() {
+        unresolved.clear();
+
+        for (const Fixup &fixup : fixups) {
+            ResolveFixup(fixup);
+        }
 
-            row.tokens.emplace_back(token);
+        ThrowUnresolved();
+    }
+
+    void ResolveFixup(const Fixup &fixup) {
+        const Symbol &target = symbols[fixup.symbol];
+        const std::span<u8> assembled = lines.Assembled(fixup.row);
+
+        if (!target.defined) {
+            unresolved.push_back(std::format("Undefined symbol {} at line {}", target.name, lines.line[fixup.row]));
+            return;
         }
 
-        if (!lines.empty()) {
-            row.offset = lines.back().offset;
+        switch (fixup.kind) {
+            case FixupKind::Relative8: {
+                const i16 offset = static_cast<i16>(target.value - lines.End(fixup.row));
+
+                if (offset < -128 || offset > 127) {
+                    unresolved.push_back(std::format("Branch to {} out of range at line {}", target.name, lines.line[fixup.row]));
+                    return;
+                }
+
+                assembled.back() = offset;
+                break;
+            }
+            case FixupKind::Absolute8:
+                if (target.value > 0xFF) {
+                    unresolved.push_back(std::format("Symbol {} does not fit in a byte at line {}", target.name, lines.line[fixup.row]));
+                    return;
+                }
+
+                assembled.back() = target.value;
+                break;
+            case FixupKind::Absolute16:
+                assembled[assembled.size() - 2] = target.value >> 8;
+                assembled.back() = target.value;
+                break;
         }
+    }
 
-        if (row.tokens.empty())
-            return row;
+    void AssembleSingleLine(const SourceLine& source) {
+        const u16 address = lines.empty() ? 0 : lines.End(lines.size() - 1);
+        const u32 byteOffset = lines.bytes.size();
 
-        std::string instruction = row.tokens[0];
-        row.instruction = GetInstructionByMnemonic(row.tokens[0]);
+        lines.raw.push_back(source.text);
+        lines.line.push_back(source.line);
+        lines.label.push_back(NoSymbol);
+        lines.instruction.push_back(RowTable::NoInstruction);
+        lines.mode.push_back(Assembler_AddressingMode::INHERENT);
+        lines.referencedLabel.push_back(NoSymbol);
+        lines.byteOffset.push_back(byteOffset);
+        lines.byteCount.push_back(0);
+        lines.address.push_back(address);
+
+        if (source.tokenCount == 0)
+            return;
+
+        std::string_view label;
+        std::string_view mnemonic = source.tokens[0].text;
+        InstructionRef instruction = GetInstructionByMnemonic(mnemonic);
 
         // NOTE(alex): columns beginning with '*' are comments
-        if (instruction.front() == '*')
-            return row;
+        if (mnemonic.front() == '*')
+            return;
 
         // NOTE(alex): if the first column does not contain an instruction, it is a label
-        if (!row.instruction) {
-            if (instruction.front() == '#' || instruction.front() == '$' || isdigit(instruction.front())) {
+        if (!instruction) {
+            if (mnemonic.front() == '#' || IsNumberPrefix(mnemonic.front())) {
                 throw std::runtime_error("Invalid label name");
             }
 
-            row.label = instruction;
-            row.instruction = GetInstructionByMnemonic(row.tokens[1]);
+            label = mnemonic;
+            instruction = source.tokenCount > 1 ? GetInstructionByMnemonic(source.tokens[1].text) : nullptr;
         }
 
-        if (!row.instruction) {
+        if (!instruction) {
             throw std::runtime_error("Invalid instruction mnemonic");
         }
 
-        row.mode = Assembler_AddressingMode::INHERENT;
+        auto mode = Assembler_AddressingMode::INHERENT;
 
         // NOTE(alex): if the column has a label, the operand is the third token rather than the second
-        if (row.tokens.size() > (row.label.empty() ? 1 : 2)) {
-            std::string &operand = row.tokens[row.label.empty() ? 1 : 2];
-
-            if (!IsStringNumber(operand)
-                && !isdigit(operand.front())
-                && operand.front() != '#'
-                && operand.front() != '$'
-                && row.instruction->IsAddressingModeSupported(Assembler_AddressingMode::RELATIVE)) {
-                row.mode = Assembler_AddressingMode::RELATIVE;
+        const u8 operandIndex = label.empty() ? 1 : 2;
+        const Token *operand = source.tokenCount > operandIndex ? &source.tokens[operandIndex] : nullptr;
+
+        // NOTE: the operand without its mode markers: a number, a symbol or empty (",X" means a zero offset)
+        std::string_view value;
+        char force = 0;
+
+        if (operand) {
+            value = operand->text;
+
+            if (value.front() == '#') {
+                mode = Assembler_AddressingMode::IMMEDIATE;
+                value.remove_prefix(1);
+            } else if (value.ends_with(",X")) {
+                mode = Assembler_AddressingMode::INDEXED_X;
+                value.remove_suffix(2);
+            } else if (value.ends_with(",Y")) {
+                mode = Assembler_AddressingMode::INDEXED_Y;
+                value.remove_suffix(2);
+            } else if (value.front() == '<' || value.front() == '>') {
+                // NOTE: '<' forces the direct form and '>' the extended one
+                force = value.front();
+                value.remove_prefix(1);
+            }
+        }
+
+        const bool symbolic = !value.empty() && !IsNumberPrefix(value.front());
+        const bool directive = instruction == ReservedDirectives::OrgInst || instruction == ReservedDirectives::RmbInst;
+        const u16 number = value.empty() || symbolic ? 0 : ParseNumber(*operand, value);
+
+        const bool hasDirect = instruction->IsAddressingModeSupported(Assembler_AddressingMode::DIRECT);
+        const bool hasExtended = instruction->IsAddressingModeSupported(Assembler_AddressingMode::EXTENDED);
+
+        // NOTE: a symbol starts out in the short form and is only relaxed to the long one by Layout() if it has to be
+        bool relaxable = false;
+
+        if (operand && mode == Assembler_AddressingMode::INHERENT) {
+            if (symbolic && !force && instruction->IsAddressingModeSupported(Assembler_AddressingMode::RELATIVE)) {
+                mode = Assembler_AddressingMode::RELATIVE;
+                relaxable = true;
+            } else if (force) {
+                mode = force == '<' ? Assembler_AddressingMode::DIRECT : Assembler_AddressingMode::EXTENDED;
+            } else if (symbolic) {
+                mode = hasDirect ? Assembler_AddressingMode::DIRECT : Assembler_AddressingMode::EXTENDED;
+                relaxable = hasDirect && hasExtended && !directive;
             } else {
-                switch (operand.front()) {
-                    case '#':
-                        row.mode = Assembler_AddressingMode::IMMEDIATE;
-                        operand.erase(0, 1);
-                        break;
-                    case '$':
-                        row.mode = Assembler_AddressingMode::EXTENDED;
-                        break;
-                    default:
-                        row.mode = Assembler_AddressingMode::DIRECT;
-                        break;
+                mode = hasDirect && (number <= 0xFF || !hasExtended)
+                    ? Assembler_AddressingMode::DIRECT
+                    : Assembler_AddressingMode::EXTENDED;
+            }
+        }
+
+        if (!instruction->IsAddressingModeSupported(mode)) {
+            throw std::runtime_error("Invalid addressing mode");
+        }
+
+        const sz_t row = lines.size() - 1;
+        lines.instruction[row] = instruction - AllInstructions.data();
+        lines.mode[row] = mode;
+
+        const Operation &operation = instruction->GetOperation(mode);
+        auto &bytes = lines.bytes;
+        bytes.insert(bytes.end(), operation.opcodes.begin(), operation.opcodes.end());
+
+        if (symbolic) {
+            lines.referencedLabel[row] = symbols.Intern(value);
+        }
+
+        if (mode == Assembler_AddressingMode::INHERENT) {
+            // NOTE: no operand
+        } else if (symbolic && !directive) {
+            // NOTE: placeholder bytes, patched once every symbol is known
+            const FixupKind kind = mode == Assembler_AddressingMode::RELATIVE ? FixupKind::Relative8
+                : operation.byteCount == 2 ? FixupKind::Absolute16 : FixupKind::Absolute8;
+
+            bytes.resize(bytes.size() + (kind == FixupKind::Absolute16 ? 2 : 1));
+            AddFixup(row, lines.referencedLabel[row], kind, relaxable);
+        } else {
+            u16 operandValue = number;
+
+            if (symbolic) {
+                // NOTE: the location counter depends on it, so it has to be defined by an earlier row
+                const Symbol &symbol = symbols[lines.referencedLabel[row]];
+
+                if (!symbol.defined) {
+                    throw std::runtime_error(std::format("Undefined symbol {}", symbol.name));
                 }
 
-                switch (operand.back()) {
-                    case 'X':
-                        row.mode = Assembler_AddressingMode::INDEXED_X;
+                operandValue = symbol.value;
+            }
+
+            if (instruction == ReservedDirectives::OrgInst) {
+                lines.address[row] = operandValue;
+            } else if (instruction == ReservedDirectives::RmbInst) {
+                bytes.resize(bytes.size() + operandValue);
+            } else {
+                switch (operation.byteCount) {
+                    case 1:
+                        if (operandValue > 0xFF) {
+                            throw std::runtime_error(std::format(
+                                    "Operand {} does not fit in a byte at line {}, column {}", value, operand->line,
+                                    operand->column));
+                        }
+
+                        bytes.emplace_back(operandValue);
                         break;
-                    case 'Y':
-                        row.mode = Assembler_AddressingMode::INDEXED_Y;
+                    case 2:
+                        bytes.emplace_back(operandValue >> 8);
+                        bytes.emplace_back(operandValue);
                         break;
                 }
             }
         }
 
-        try {
-            const Operation &operation = row.instruction->opcodes.at(row.mode);
-            row.assembled.insert(row.assembled.begin(), operation.opcodes.begin(), operation.opcodes.end());
-
-            if (row.mode != Assembler_AddressingMode::INHERENT && row.mode != Assembler_AddressingMode::RELATIVE) {
-                // NOTE(alex): if the column has a label, the operand is the third token rather than the second
-                std::string operand = row.tokens[row.label.empty() ? 1 : 2];
-
-                u16 value = 0;
-                // NOTE(alex): hex values begin with $
-                if (operand.front() == '$') {
-                    operand.erase(0, 1);
-                    value = std::stoul(operand, nullptr, 16);
-                } else {
-                    value = std::stoul(operand, nullptr, 10);
-                }
-
-                if (row.instruction == ReservedDirectives::OrgInst) {
-                    row.offset = value;
-                } else if (row.instruction == ReservedDirectives::RmbInst) {
-                    for (u16 i = 0; i < value; i++) {
-                        row.assembled.emplace_back();
-                    }
-                } else {
-                    switch (operation.byteCount) {
-                        case 1:
-                            row.assembled.emplace_back(value);
-                            break;
-                            case 2:
-                                row.assembled.emplace_back(value >> 8);
-                                row.assembled.emplace_back(value);
-                                break;
-                    }
-                }
-            } else if (row.mode == Assembler_AddressingMode::RELATIVE) {
-                // NOTE(alex): dummy byte to be replaced at the branch pass
-                row.assembled.emplace_back();
-
-                std::string referencedLabel = row.tokens[row.label.empty() ? 1 : 2];
-                row.referencedLabel = referencedLabel;
+        lines.byteCount[row] = bytes.size() - byteOffset;
+
+        if (!label.empty()) {
+            lines.label[row] = symbols.Intern(label);
+
+            if (symbols[lines.label[row]].defined) {
+                throw std::runtime_error("Duplicate label");
             }
 
-            if (!row.label.empty())
-                labelAddresses.insert_or_assign(row.label, row.offset);
-        } catch (std::out_of_range& e) {
-            throw std::runtime_error("Invalid addressing mode");
+            symbols.Define(lines.label[row], lines.address[row]);
         }
 
-        if (!lines.empty())
-            row.offset += row.assembled.size();
+        if (lines.byteCount[row] > longest)
+            longest = lines.byteCount[row];
+    }
 
-        if (row.assembled.size() > longest)
-            longest = row.assembled.size();
+private:
+    // NOTE: declared first so it outlives every container allocating from it
+    Arena arena;
 
-        return row;
+public:
+    SymbolTable symbols { &arena };
+    RowTable lines { &arena, symbols };
+    // NOTE: every use of a symbol as an operand, in row order
+    std::pmr::vector<Fixup> fixups { &arena };
+    // NOTE: messages of the uses the last resolution could not patch
+    std::vector<std::string> unresolved;
+    std::deque<std::string> sources;
+    std::deque<MappedFile> mappings;
+    u16 longest = 0;
+
+private:
+    void Rebuild(std::string text) {
+        Reset();
+
+        const std::string &source = sources.emplace_back(std::move(text));
+        AssembleSource(std::span<const char>(source));
+
+        liveBytes = lines.bytes.size();
+        editable = true;
+
+        Layout();
+        ResolveFixups();
+        resolved = true;
     }
 
-    std::unordered_map<std::string, u16> labelAddresses;
-    std::stringstream stream;
-    std::vector<Row> lines;
-    u16 longest;
+    void AddFixup(sz_t row, SymbolId symbol, FixupKind kind, bool relaxable) {
+        const u32 index = fixups.size();
+        fixups.push_back({ static_cast<u32>(row), symbol, kind, relaxable, symbols.ChainFixup(symbol, index) });
+    }
+
+    // NOTE: rebuilds every chain after fixups were moved around
+    void ChainFixups() {
+        symbols.UnchainFixups();
+
+        for (u32 i = 0; i < fixups.size(); i++) {
+            fixups[i].next = symbols.ChainFixup(fixups[i].symbol, i);
+        }
+    }
+
+    void ThrowUnresolved() const {
+        if (unresolved.empty())
+            return;
+
+        std::string message = unresolved.front();
+        for (sz_t i = 1; i < unresolved.size(); i++) {
+            message.append("\n").append(unresolved[i]);
+        }
+
+        throw std::runtime_error(message);
+    }
+
+    // NOTE: bytes of rows that were replaced by edits; the shared byte buffer only ever grows until the next rebuild
+    [[nodiscard]] sz_t Garbage() const {
+        return lines.bytes.size() - liveBytes;
+    }
+
+    sz_t UpdateChangedLines(std::string text) {
+        const std::string_view before = sources.front();
+        const std::string_view after = sources.emplace_back(std::move(text));
+        const sz_t beforeSize = before.size();
+        const sz_t afterSize = after.size();
+
+        if (before == after) {
+            sources.pop_back();
+
+            // NOTE: the same text again still has to report a branch that failed to resolve last time
+            if (!resolved) {
+                ResolveFixups();
+                resolved = true;
+            }
+
+            return lines.size();
+        }
+
+        // NOTE: the unchanged start is cut back to the beginning of the first edited line
+        const sz_t common = std::mismatch(before.begin(), before.end(), after.begin(), after.end()).first - before.begin();
+        const sz_t lastNewline = before.substr(0, common).rfind('\n');
+        const sz_t prefix = lastNewline == std::string_view::npos ? 0 : lastNewline + 1;
+
+        // NOTE: the unchanged end has to begin on a line boundary in both texts
+        sz_t suffix = 0;
+        while (suffix < std::min(beforeSize, afterSize) - prefix
+               && before[beforeSize - 1 - suffix] == after[afterSize - 1 - suffix]) {
+            suffix++;
+        }
+
+        const auto isLineStart = [](std::string_view text, sz_t position) {
+            return position == 0 || text[position - 1] == '\n';
+        };
+
+        sz_t beforeTail = beforeSize - suffix;
+        sz_t afterTail = afterSize - suffix;
+        while (beforeTail < beforeSize && !(isLineStart(before, beforeTail) && isLineStart(after, afterTail))) {
+            beforeTail++;
+            afterTail++;
+        }
+
+        const auto firstRowAt = [&](sz_t position) -> sz_t {
+            const char *target = before.data() + position;
+            return std::lower_bound(lines.raw.begin(), lines.raw.end(), target, [](std::string_view raw, const char *at) {
+                return raw.data() < at;
+            }) - lines.raw.begin();
+        };
+
+        const sz_t first = firstRowAt(prefix);
+        const sz_t tail = beforeTail == beforeSize ? lines.size() : firstRowAt(beforeTail);
+
+        // NOTE: labels of replaced rows disappear; they come back below if the edited lines still define them
+        std::vector<bool> changed(symbols.size());
+        for (sz_t i = first; i < tail; i++) {
+            liveBytes -= lines.byteCount[i];
+
+            if (lines.label[i] != NoSymbol) {
+                symbols.Undefine(lines.label[i]);
+                changed[lines.label[i]] = true;
+            }
+        }
+
+        RowTable tailRows(std::pmr::new_delete_resource(), symbols);
+        tailRows.AppendRows(lines, tail, lines.size());
+
+        const auto firstFixupAt = [&](sz_t row) -> sz_t {
+            return std::lower_bound(fixups.begin(), fixups.end(), row, [](const Fixup &fixup, sz_t at) {
+                return fixup.row < at;
+            }) - fixups.begin();
+        };
+
+        const sz_t firstFixup = firstFixupAt(first);
+        const std::vector<Fixup> tailFixups(fixups.begin() + firstFixupAt(tail), fixups.end());
+        fixups.resize(firstFixup);
+
+        // NOTE: the old text dies at the end of the update, so every kept row is rebased onto the new one
+        editable = false;
+        const char *oldBase = before.data();
+        const char *newBase = after.data();
+        for (sz_t i = 0; i < first; i++)
+            lines.raw[i] = { newBase + (lines.raw[i].data() - oldBase), lines.raw[i].size() };
+
+        lines.Truncate(first);
+
+        const sz_t bytesBefore = lines.bytes.size();
+        Lexer lexer(after.substr(prefix, afterTail - prefix), first + 1);
+        for (SourceLine line; lexer.Next(line);) {
+            AssembleSingleLine(line);
+        }
+
+        liveBytes += lines.bytes.size() - bytesBefore;
+
+        const sz_t middleEnd = lines.size();
+        const i64 lineShift = static_cast<i64>(middleEnd) - static_cast<i64>(tail);
+        changed.resize(symbols.size());
+
+        for (sz_t i = first; i < middleEnd; i++) {
+            if (lines.label[i] != NoSymbol)
+                changed[lines.label[i]] = true;
+        }
+
+        const sz_t middleFixupEnd = fixups.size();
+        for (Fixup fixup : tailFixups) {
+            fixup.row += lineShift;
+            fixups.push_back(fixup);
+        }
+
+        ChainFixups();
+
+        lines.AppendRows(tailRows, 0, tailRows.size());
+
+        const char *newTailBase = newBase + afterTail - beforeTail;
+        for (sz_t i = middleEnd; i < lines.size(); i++) {
+            const std::string_view raw = lines.raw[i];
+            lines.raw[i] = { newTailBase + (raw.data() - oldBase), raw.size() };
+            lines.line[i] += lineShift;
+        }
+
+        sources.pop_front();
+        editable = true;
+
+        const bool resolveAll = !resolved;
+        resolved = false;
+
+        // NOTE: relaxation can move rows on either side of the edit, so the whole program is laid out again; this only
+        // walks the columns, nothing is lexed or parsed
+        std::vector<bool> moved;
+        Layout(moved, changed);
+
+        // NOTE: uses on edited rows, on moved rows and every use of a symbol that changed, found through its chain;
+        // they are still patched in fixup order so errors come out as a full pass would report them
+        std::vector<bool> pending(fixups.size(), resolveAll);
+        std::fill(pending.begin() + firstFixup, pending.begin() + middleFixupEnd, true);
+
+        for (sz_t i = 0; i < fixups.size(); i++) {
+            if (moved[fixups[i].row])
+                pending[i] = true;
+        }
+
+        for (SymbolId id = 0; id < changed.size(); id++) {
+            if (!changed[id])
+                continue;
+
+            for (u32 fixup = symbols[id].fixups; fixup != NoFixup; fixup = fixups[fixup].next) {
+                pending[fixup] = true;
+            }
+        }
+
+        unresolved.clear();
+        for (sz_t i = 0; i < fixups.size(); i++) {
+            if (pending[i])
+                ResolveFixup(fixups[i]);
+        }
+
+        ThrowUnresolved();
+        resolved = true;
+
+        const auto firstMoved = std::find(moved.begin(), moved.end(), true);
+        return std::min<sz_t>(first, firstMoved - moved.begin());
+    }
+
+    // NOTE: places every row at its final address. A relaxable operand starts out in its short form and switches to
+    // the long one once its symbol is out of reach; rows only ever grow, so repeating this until nothing switches
+    // terminates. Flags rows whose address or bytes changed in moved and symbols whose value changed in changed.
+    void Layout(std::vector<bool> &moved, std::vector<bool> &changed) {
+        moved.assign(lines.size(), false);
+        changed.resize(symbols.size());
+
+        std::vector<u32> relaxableFixup(lines.size(), NoFixup);
+        for (u32 i = 0; i < fixups.size(); i++) {
+            if (fixups[i].relaxable)
+                relaxableFixup[fixups[i].row] = i;
+        }
+
+        std::vector<Symbol> previousSymbols;
+        previousSymbols.reserve(symbols.size());
+        for (SymbolId id = 0; id < symbols.size(); id++) {
+            previousSymbols.push_back(symbols[id]);
+        }
+
+        const std::vector<u16> previousAddresses(lines.address.begin(), lines.address.end());
+        std::vector<bool> relaxed(lines.size());
+        std::vector<bool> placed(symbols.size());
+
+        for (bool grew = true; grew;) {
+            grew = false;
+            std::fill(placed.begin(), placed.end(), false);
+
+            u16 address = 0;
+            for (sz_t i = 0; i < lines.size(); i++) {
+                const InstructionRef instruction = lines.Instruction(i);
+                const SymbolId operand = lines.referencedLabel[i];
+                const bool directive = instruction == ReservedDirectives::OrgInst
+                    || instruction == ReservedDirectives::RmbInst;
+
+                // NOTE: an edit may have moved the definition a directive depends on below it
+                if (directive && operand != NoSymbol && !placed[operand]) {
+                    throw std::runtime_error(std::format("Undefined symbol {}", symbols.Name(operand)));
+                }
+
+                u16 size = lines.byteCount[i];
+
+                if (instruction == ReservedDirectives::OrgInst) {
+                    address = operand == NoSymbol ? lines.address[i] : symbols[operand].value;
+                } else if (instruction == ReservedDirectives::RmbInst && operand != NoSymbol) {
+                    size = symbols[operand].value;
+                } else if (relaxableFixup[i] != NoFixup) {
+                    size = EncodedSize(i, relaxed[i]);
+                }
+
+                lines.address[i] = address;
+
+                if (lines.label[i] != NoSymbol) {
+                    symbols.Define(lines.label[i], address);
+                    placed[lines.label[i]] = true;
+                }
+
+                address += size;
+            }
+
+            for (const Fixup &fixup : fixups) {
+                if (!fixup.relaxable || relaxed[fixup.row] || FitsShortForm(fixup))
+                    continue;
+
+                relaxed[fixup.row] = true;
+                grew = true;
+            }
+        }
+
+        for (sz_t i = 0; i < lines.size(); i++) {
+            const SymbolId operand = lines.referencedLabel[i];
+
+            if (lines.Instruction(i) == ReservedDirectives::RmbInst && operand != NoSymbol) {
+                if (lines.byteCount[i] != symbols[operand].value) {
+                    const std::span<u8> reserved = ResizeRow(i, symbols[operand].value);
+                    std::fill(reserved.begin(), reserved.end(), 0);
+                    moved[i] = true;
+                }
+            } else if (relaxableFixup[i] != NoFixup && IsLongForm(i) != relaxed[i]) {
+                Encode(i, fixups[relaxableFixup[i]], relaxed[i]);
+                moved[i] = true;
+            }
+
+            if (lines.address[i] != previousAddresses[i])
+                moved[i] = true;
+        }
+
+        for (SymbolId id = 0; id < previousSymbols.size(); id++) {
+            if (symbols[id].defined != previousSymbols[id].defined || symbols[id].value != previousSymbols[id].value)
+                changed[id] = true;
+        }
+    }
+
+    void Layout() {
+        std::vector<bool> moved;
+        std::vector<bool> changed;
+        Layout(moved, changed);
+    }
+
+    // NOTE: a branch keeps the 8-bit displacement while it reaches, a direct operand while it stays in page zero;
+    // uses of undefined symbols stay short and are reported by ResolveFixups()
+    [[nodiscard]] bool FitsShortForm(const Fixup &fixup) const {
+        const Symbol &target = symbols[fixup.symbol];
+
+        if (!target.defined)
+            return true;
+
+        if (lines.mode[fixup.row] == Assembler_AddressingMode::RELATIVE) {
+            const i16 offset = static_cast<i16>(target.value - (lines.address[fixup.row] + 2));
+            return offset >= -128 && offset <= 127;
+        }
+
+        return target.value <= 0xFF;
+    }
+
+    [[nodiscard]] bool IsLongForm(sz_t row) const {
+        return lines.mode[row] == Assembler_AddressingMode::RELATIVE
+            ? lines.byteCount[row] > 2
+            : lines.mode[row] == Assembler_AddressingMode::EXTENDED;
+    }
+
+    [[nodiscard]] u16 EncodedSize(sz_t row, bool longForm) const {
+        const InstructionRef instruction = lines.Instruction(row);
+
+        if (lines.mode[row] == Assembler_AddressingMode::RELATIVE) {
+            const u8 opcode = *instruction->GetOperation(Assembler_AddressingMode::RELATIVE).opcodes.begin();
+
+            if (!longForm)
+                return 2;
+
+            return opcode == BranchAlways || opcode == BranchToSubroutine ? 3 : 5;
+        }
+
+        const Operation &operation = instruction->GetOperation(
+            longForm ? Assembler_AddressingMode::EXTENDED : Assembler_AddressingMode::DIRECT);
+
+        return operation.opcodes.size() + operation.byteCount;
+    }
+
+    // NOTE: the long form of a branch: BRA and BSR turn into JMP and JSR, any other branch jumps over a JMP on the
+    // opposite condition (the low opcode bit flips the condition of every conditional branch)
+    static constexpr u8 BranchAlways = 0x20;
+    static constexpr u8 BranchToSubroutine = 0x8D;
+    static constexpr u8 JumpExtended = 0x7E;
+    static constexpr u8 JumpToSubroutineExtended = 0xBD;
+
+    void Encode(sz_t row, Fixup &fixup, bool longForm) {
+        const InstructionRef instruction = lines.Instruction(row);
+        std::array<u8, 5> encoding {};
+        sz_t size = 0;
+
+        if (lines.mode[row] == Assembler_AddressingMode::RELATIVE) {
+            const u8 opcode = *instruction->GetOperation(Assembler_AddressingMode::RELATIVE).opcodes.begin();
+
+            if (!longForm) {
+                encoding[size++] = opcode;
+                size++;
+            } else if (opcode == BranchAlways || opcode == BranchToSubroutine) {
+                encoding[size++] = opcode == BranchAlways ? JumpExtended : JumpToSubroutineExtended;
+                size += 2;
+            } else {
+                encoding[size++] = opcode ^ 1;
+                encoding[size++] = 3;
+                encoding[size++] = JumpExtended;
+                size += 2;
+            }
+
+            fixup.kind = longForm ? FixupKind::Absolute16 : FixupKind::Relative8;
+        } else {
+            const auto mode = longForm ? Assembler_AddressingMode::EXTENDED : Assembler_AddressingMode::DIRECT;
+            const Operation &operation = instruction->GetOperation(mode);
+            lines.mode[row] = mode;
+
+            for (const u8 opcode : operation.opcodes) {
+                encoding[size++] = opcode;
+            }
+
+            size += operation.byteCount;
+            fixup.kind = operation.byteCount == 2 ? FixupKind::Absolute16 : FixupKind::Absolute8;
+        }
+
+        const std::span<u8> bytes = ResizeRow(row, size);
+        std::copy_n(encoding.begin(), size, bytes.begin());
+    }
+
+    // NOTE: a row that grows moves to the end of the shared byte buffer, one that shrinks stays where it is; either
+    // way the bytes it leaves behind are garbage until the next rebuild
+    std::span<u8> ResizeRow(sz_t row, sz_t size) {
+        if (size > lines.byteCount[row]) {
+            lines.byteOffset[row] = lines.bytes.size();
+            lines.bytes.resize(lines.bytes.size() + size);
+        }
+
+        liveBytes = liveBytes + size - lines.byteCount[row];
+        lines.byteCount[row] = size;
+
+        if (size > longest)
+            longest = size;
+
+        return lines.Assembled(row);
+    }
+
+    void AssembleSource(std::span<const char> source) {
+        Lexer lexer(std::string_view(source.data(), source.size()));
+
+        // NOTE: rough guess at the row count so the columns rarely have to grow
+        lines.Reserve(lines.size() + source.size() / 16);
+
+        for (SourceLine line; lexer.Next(line);) {
+            AssembleSingleLine(line);
+        }
+    }
+
+    // NOTE: copies a fed line into the current block; blocks are reserved up front and never reallocate, so views
+    // into them stay valid
+    std::string_view StoreLine(std::string_view text) {
+        if (sources.empty() || sources.back().capacity() - sources.back().size() < text.size()) {
+            sources.emplace_back().reserve(std::max(FeedBlockSize, text.size()));
+        }
+
+        std::string &block = sources.back();
+        const sz_t start = block.size();
+        block.append(text);
+
+        return std::string_view(block).substr(start, text.size());
+    }
+
+    std::string pending;
+    u32 feedLine = 1;
+
+    // NOTE: state for Update(): whether the rows describe the single source line for line, whether every branch is
+    // patched, and how many bytes of the shared buffer still belong to a row
+    bool editable = false;
+    bool resolved = false;
+    sz_t liveBytes = 0;
 };
 
 #endif //M68HC11_ASSEMBLER_H
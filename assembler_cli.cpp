@@ -0,0 +1,374 @@
+#include "assembler.h"
+#include "batchassembler.h"
+#include "image.h"
+#include "m68hc11x.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace {
+    enum class ImageFormat {
+        Binary,
+        SRecord,
+        IntelHex
+    };
+
+    struct Output {
+        std::string path;
+        ImageFormat format;
+    };
+
+    struct Options {
+        std::vector<std::string> inputs;
+        std::vector<Output> outputs;
+        std::vector<ImageFormat> formats;
+        std::string listing;
+        bool listings = false;
+        std::optional<u16> entry;
+        u8 fill = 0xFF;
+        sz_t threads = std::max(1u, std::thread::hardware_concurrency());
+        bool timings = false;
+    };
+
+    void PrintUsage() {
+        std::cerr << "usage: m68hc11-as [options] <input.asm | @project | ->...\n"
+                     "  -o <file>        write an image; the format follows the extension\n"
+                     "                   (.bin, .s19/.s/.srec, .hex/.ihx), may be repeated\n"
+                     "  -l <file>        write a listing with the symbol table\n"
+                     "  -f <format>      with several inputs: write <name>.<format> for each\n"
+                     "                   (bin, s19, hex), may be repeated\n"
+                     "  -L               with several inputs: write <name>.lst for each\n"
+                     "  -j <threads>     assemble inputs in parallel (default: one per core)\n"
+                     "  --timings        report the time taken by each input\n"
+                     "  --entry <addr>   entry point for the S9 record (default: lowest address)\n"
+                     "  --fill <byte>    fill value for gaps in binary images (default: $FF)\n"
+                     "A @project file lists one module per line; its modules are assembled together into one image.\n"
+                     "With no -o or -f, <name>.s19 is written. '-' reads a single source from stdin.\n";
+    }
+
+    std::optional<u32> ParseArgNumber(std::string_view text) {
+        int base = 10;
+
+        if (text.starts_with('$')) {
+            base = 16;
+            text.remove_prefix(1);
+        } else if (text.starts_with("0x") || text.starts_with("0X")) {
+            base = 16;
+            text.remove_prefix(2);
+        }
+
+        u32 value = 0;
+        const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value, base);
+
+        if (error != std::errc() || end != text.data() + text.size())
+            return std::nullopt;
+
+        return value;
+    }
+
+    std::optional<ImageFormat> FormatFromExtension(std::string extension) {
+        std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+        if (extension == "bin")
+            return ImageFormat::Binary;
+        if (extension == "s19" || extension == "s" || extension == "srec")
+            return ImageFormat::SRecord;
+        if (extension == "hex" || extension == "ihx")
+            return ImageFormat::IntelHex;
+
+        return std::nullopt;
+    }
+
+    std::optional<ImageFormat> FormatFromPath(const std::string &path) {
+        const std::string extension = std::filesystem::path(path).extension().string();
+        return extension.empty() ? std::nullopt : FormatFromExtension(extension.substr(1));
+    }
+
+    std::string_view FormatExtension(ImageFormat format) {
+        switch (format) {
+            case ImageFormat::Binary:
+                return ".bin";
+            case ImageFormat::SRecord:
+                return ".s19";
+            case ImageFormat::IntelHex:
+                return ".hex";
+        }
+
+        return "";
+    }
+
+    std::optional<Options> ParseOptions(i32 argc, char **argv) {
+        Options options;
+
+        for (i32 i = 1; i < argc; i++) {
+            const std::string_view arg = argv[i];
+            const bool hasValue = i + 1 < argc;
+
+            if (arg == "-o" && hasValue) {
+                const std::string path = argv[++i];
+                const std::optional<ImageFormat> format = FormatFromPath(path);
+
+                if (!format) {
+                    std::cerr << std::format("m68hc11-as: unknown image format for {}\n", path);
+                    return std::nullopt;
+                }
+
+                options.outputs.push_back({ path, *format });
+            } else if (arg == "-l" && hasValue) {
+                options.listing = argv[++i];
+            } else if (arg == "-f" && hasValue) {
+                const std::optional<ImageFormat> format = FormatFromExtension(argv[++i]);
+
+                if (!format) {
+                    std::cerr << std::format("m68hc11-as: unknown image format {}\n", argv[i]);
+                    return std::nullopt;
+                }
+
+                options.formats.push_back(*format);
+            } else if (arg == "-L") {
+                options.listings = true;
+            } else if (arg == "-j" && hasValue) {
+                const std::optional<u32> threads = ParseArgNumber(argv[++i]);
+
+                if (!threads || *threads == 0) {
+                    std::cerr << "m68hc11-as: invalid thread count\n";
+                    return std::nullopt;
+                }
+
+                options.threads = *threads;
+            } else if (arg == "--timings") {
+                options.timings = true;
+            } else if (arg == "--entry" && hasValue) {
+                const std::optional<u32> entry = ParseArgNumber(argv[++i]);
+
+                if (!entry || *entry > 0xFFFF) {
+                    std::cerr << "m68hc11-as: invalid entry address\n";
+                    return std::nullopt;
+                }
+
+                options.entry = *entry;
+            } else if (arg == "--fill" && hasValue) {
+                const std::optional<u32> fill = ParseArgNumber(argv[++i]);
+
+                if (!fill || *fill > 0xFF) {
+                    std::cerr << "m68hc11-as: invalid fill byte\n";
+                    return std::nullopt;
+                }
+
+                options.fill = *fill;
+            } else if (arg == "-" || !arg.starts_with('-')) {
+                options.inputs.emplace_back(arg);
+            } else {
+                return std::nullopt;
+            }
+        }
+
+        if (options.inputs.empty())
+            return std::nullopt;
+
+        const bool single = options.inputs.size() == 1;
+
+        if (!single && (!options.outputs.empty() || !options.listing.empty())) {
+            std::cerr << "m68hc11-as: -o and -l need a single input, use -f and -L with several\n";
+            return std::nullopt;
+        }
+
+        if (!single && std::find(options.inputs.begin(), options.inputs.end(), "-") != options.inputs.end()) {
+            std::cerr << "m68hc11-as: stdin cannot be combined with other inputs\n";
+            return std::nullopt;
+        }
+
+        if (options.outputs.empty() && options.formats.empty())
+            options.formats.push_back(ImageFormat::SRecord);
+
+        return options;
+    }
+
+    // NOTE: a project file lists one module per line, relative to the project file; blank lines and lines starting
+    // with '#' are skipped
+    AssemblyJob LoadProject(const std::string &path) {
+        std::ifstream project(path);
+
+        if (!project)
+            throw std::runtime_error(std::format("cannot read {}", path));
+
+        const std::filesystem::path directory = std::filesystem::path(path).parent_path();
+        AssemblyJob job = { std::filesystem::path(path).replace_extension().string(), {} };
+
+        for (std::string line; std::getline(project, line);) {
+            const sz_t first = line.find_first_not_of(" \t\r");
+            const sz_t last = line.find_last_not_of(" \t\r");
+
+            if (first == std::string::npos || line[first] == '#')
+                continue;
+
+            job.sources.push_back((directory / line.substr(first, last - first + 1)).string());
+        }
+
+        return job;
+    }
+
+    std::vector<AssemblyJob> CreateJobs(const Options &options) {
+        std::vector<AssemblyJob> jobs;
+
+        for (const std::string &input : options.inputs) {
+            if (input.starts_with('@'))
+                jobs.push_back(LoadProject(input.substr(1)));
+            else
+                jobs.push_back({ std::filesystem::path(input).replace_extension().string(), { input } });
+        }
+
+        return jobs;
+    }
+
+    void AssembleStdin(Assembler &assembler) {
+        std::vector<char> chunk(Assembler::FeedBlockSize);
+
+        for (sz_t read; (read = std::fread(chunk.data(), 1, chunk.size(), stdin)) > 0;)
+            assembler.Feed(std::span(chunk.data(), read));
+
+        assembler.Finish();
+    }
+
+    bool WriteOutput(const Output &output, const Image &image, const Options &options) {
+        std::ofstream out(output.path, std::ios::binary);
+
+        if (!out) {
+            std::cerr << std::format("m68hc11-as: cannot write {}\n", output.path);
+            return false;
+        }
+
+        switch (output.format) {
+            case ImageFormat::Binary:
+                image.WriteBinary(out, options.fill);
+                break;
+            case ImageFormat::SRecord: {
+                const u16 entry = options.entry.value_or(image.empty() ? 0 : image.segments.front().address);
+                image.WriteSRecord(out, std::filesystem::path(output.path).filename().string(), entry);
+                break;
+            }
+            case ImageFormat::IntelHex:
+                image.WriteIntelHex(out);
+                break;
+        }
+
+        return static_cast<bool>(out);
+    }
+
+    bool WriteOutputs(const std::string &name, const Assembler &assembler, const Options &options) {
+        const Image image = Image::FromRows(assembler.lines);
+        std::vector<Output> outputs = options.outputs;
+
+        for (const ImageFormat format : options.formats)
+            outputs.push_back({ name + std::string(FormatExtension(format)), format });
+
+        for (const Output &output : outputs) {
+            if (!WriteOutput(output, image, options))
+                return false;
+        }
+
+        std::string listingPath = options.listing;
+        if (listingPath.empty() && options.listings)
+            listingPath = name + ".lst";
+
+        if (!listingPath.empty()) {
+            std::ofstream listing(listingPath);
+
+            if (!listing) {
+                std::cerr << std::format("m68hc11-as: cannot write {}\n", listingPath);
+                return false;
+            }
+
+            WriteListing(listing, assembler);
+        }
+
+        return true;
+    }
+
+    i32 AssembleFromStdin(const Options &options) {
+        Assembler assembler;
+
+        try {
+            AssembleStdin(assembler);
+        } catch (std::runtime_error &e) {
+            if (!assembler.unresolved.empty()) {
+                for (const std::string &message : assembler.unresolved)
+                    std::cerr << std::format("<stdin>: error: {}\n", message);
+            } else if (assembler.lines.empty()) {
+                std::cerr << std::format("<stdin>: error: {}\n", e.what());
+            } else {
+                std::cerr << std::format("<stdin>:{}: error: {}\n", assembler.lines.line.back(), e.what());
+            }
+
+            return 1;
+        }
+
+        return WriteOutputs("a", assembler, options) ? 0 : 1;
+    }
+}
+
+int main(i32 argc, char **argv) {
+    const std::optional<Options> options = ParseOptions(argc, argv);
+
+    if (!options) {
+        PrintUsage();
+        return 2;
+    }
+
+    if (options->inputs.front() == "-")
+        return AssembleFromStdin(*options);
+
+    std::vector<AssemblyJob> jobs;
+
+    try {
+        jobs = CreateJobs(*options);
+    } catch (std::runtime_error &e) {
+        std::cerr << std::format("m68hc11-as: {}\n", e.what());
+        return 1;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+
+    WorkStealingPool pool(std::min(options->threads, jobs.size()));
+    const std::vector<AssemblyResult> results = AssembleBatch(jobs, pool, [&](const AssemblyJob &job, const Assembler &assembler) {
+        if (!WriteOutputs(job.name, assembler, *options))
+            throw std::runtime_error("failed to write output");
+    });
+
+    const std::chrono::duration<f64, std::milli> total = std::chrono::steady_clock::now() - start;
+    i32 status = 0;
+
+    for (const AssemblyResult &result : results) {
+        if (!result.ok()) {
+            std::string_view errors = result.error;
+
+            // NOTE: one diagnostic per line, each with the input's name in front
+            for (sz_t newline; (newline = errors.find('\n')) != std::string_view::npos; errors.remove_prefix(newline + 1))
+                std::cerr << std::format("{}: error: {}\n", result.name, errors.substr(0, newline));
+
+            std::cerr << std::format("{}: error: {}\n", result.name, errors);
+            status = 1;
+        }
+
+        if (options->timings) {
+            const std::chrono::duration<f64, std::milli> elapsed = result.elapsed;
+            std::cerr << std::format("{}: {} rows, {} bytes, {:.3f} ms\n", result.name, result.rows, result.bytes, elapsed.count());
+        }
+    }
+
+    if (options->timings)
+        std::cerr << std::format("{} inputs on {} threads in {:.3f} ms\n", jobs.size(), pool.size(), total.count());
+
+    return status;
+}
@@ -0,0 +1,342 @@
+#include "assembler.h"
+#include "batchassembler.h"
+#include "image.h"
+#include "lexer.h"
+#include "m68hc11x.h"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <filesystem>
+#include <format>
+#include <sstream>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Checks for the assembler. Sources are assembled from strings and the rows and bytes they give are checked against
+// hand-assembled code; a failed check is reported and the run exits non-zero.
+
+static i32 failures = 0;
+
+static void Check(bool condition, std::string_view what) {
+    if (!condition) {
+        std::printf("FAILED: %.*s\n", static_cast<i32>(what.size()), what.data());
+        failures++;
+    }
+}
+
+static bool Rejected(std::string source) {
+    try {
+        Assembler().Assemble(std::move(source));
+    } catch (const std::runtime_error &) {
+        return true;
+    }
+
+    return false;
+}
+
+// NOTE: every byte the rows assembled to, in row order, as "86 12 ..."
+static std::string Bytes(const Assembler &assembler) {
+    std::string out;
+
+    for (sz_t i = 0; i < assembler.lines.size(); i++) {
+        for (const u8 byte : assembler.lines.Assembled(i))
+            out.append(std::format("{}{:02x}", out.empty() ? "" : " ", byte));
+    }
+
+    return out;
+}
+
+static std::string Bytes(std::string source) {
+    Assembler assembler;
+    assembler.Assemble(std::move(source));
+    return Bytes(assembler);
+}
+
+static void TestMnemonicLookup() {
+    static_assert(InstructionMnemonics.Find("LDAA").has_value(), "the mnemonic table is built at compile time");
+
+    bool found = true;
+
+    for (const Instruction &instruction : AllInstructions)
+        found = found && GetInstructionByMnemonic(instruction.mnemonic) == &instruction;
+
+    Check(found, "every mnemonic finds its own instruction");
+
+    for (const char *mnemonic : { "", "LDA", "LDAAA", "ldaa", "LDAAXXXXX", "JMPS" })
+        Check(GetInstructionByMnemonic(mnemonic) == nullptr, std::format("'{}' is not an instruction", mnemonic));
+}
+
+static void TestOpcodeTable() {
+    const Operation &ldy = GetInstructionByMnemonic("LDY")->GetOperation(Assembler_AddressingMode::INDEXED_Y);
+    Check(ldy.supported && ldy.opcodes.size() == 2 && *ldy.opcodes.begin() == 0x18 && ldy.opcodes.begin()[1] == 0xEE
+          && ldy.byteCount == 1, "LDY n,Y is 18 EE with a one-byte offset");
+    Check(!GetInstructionByMnemonic("INCA")->IsAddressingModeSupported(Assembler_AddressingMode::IMMEDIATE),
+          "INCA has no immediate form");
+
+    Check(Bytes(" ORG $C000\n LDAA #$12\n LDY #$1234\n LDAA $10,Y\n CPD #$55AA\n LDX $2000\n CPX 3,Y\n NOP\n")
+          == "86 12 18 ce 12 34 18 a6 10 1a 83 55 aa fe 20 00 cd ac 03 01",
+          "every page of the opcode map assembles to its prefix and opcode");
+}
+
+static void TestLexer() {
+    const std::string_view text = "LOOP  LDAA  #$10  load the count";
+    const SourceLine line = Lexer::Tokenize(text, 7);
+
+    Check(line.tokenCount == 3 && line.tokens[0].text == "LOOP" && line.tokens[1].text == "LDAA"
+          && line.tokens[2].text == "#$10", "a line splits into label, mnemonic and operand");
+    Check(line.tokens[1].column == 7 && line.tokens[2].column == 13 && line.tokens[2].line == 7,
+          "tokens know their line and column");
+    Check(line.comment == "load the count", "everything after the third column is the comment");
+    Check(line.tokens[2].text.data() == text.data() + 12, "tokens are views into the source");
+
+    const std::string_view source = " NOP\r\n\n\tRTS";
+    Lexer lexer(source);
+    std::vector<SourceLine> lines;
+
+    for (SourceLine next; lexer.Next(next);)
+        lines.push_back(next);
+
+    Check(lines.size() == 3 && lines[0].text == " NOP" && lines[1].tokenCount == 0 && lines[2].line == 3
+          && lines[2].tokens[0].text == "RTS" && lines[2].tokens[0].column == 2,
+          "the lexer walks the lines of a buffer, dropping carriage returns");
+}
+
+// NOTE: labels, forward and backward references, every operand form and a comment column
+static const std::string SampleProgram =
+        " ORG $C000\n"
+        "START LDS #$FF\n"
+        " LDX #TABLE\n"
+        "LOOP LDAA 0,X  next entry\n"
+        " BEQ DONE\n"
+        " STAA $80\n"
+        " INX\n"
+        " BRA LOOP\n"
+        "DONE JMP START\n"
+        "TABLE RMB 4\n";
+
+static void TestChunkedAndMappedInput() {
+    const std::string expected = Bytes(SampleProgram);
+    Check(expected == "8e 00 ff ce c0 12 a6 00 27 05 97 80 08 20 f7 7e c0 00 00 00 00 00",
+          "the sample program assembles to its hand-assembled bytes");
+
+    Assembler fed;
+    for (sz_t i = 0; i < SampleProgram.size(); i += 7)
+        fed.Feed(std::span(SampleProgram).subspan(i, std::min<sz_t>(7, SampleProgram.size() - i)));
+    fed.Finish();
+
+    Check(Bytes(fed) == expected, "source fed in chunks assembles like a whole buffer");
+
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "m68hc11-as-tests.asm";
+    std::ofstream(path, std::ios::binary) << SampleProgram;
+
+    Assembler mapped;
+    mapped.AssembleFile(path.string());
+    Check(Bytes(mapped) == expected, "a memory-mapped file assembles like a buffer");
+
+    std::filesystem::remove(path);
+}
+
+static void TestRowStorage() {
+    std::string buffer = SampleProgram;
+    Assembler assembler;
+    assembler.Assemble(std::span<const char>(buffer));
+
+    const RowTable &rows = assembler.lines;
+    Check(rows.size() == 10 && assembler.symbols.size() == 4, "one row per line and one symbol per name");
+
+    const Row loop = rows[3], branch = rows[7];
+    Check(loop.label == "LOOP" && loop.address == 0xC006 && loop.raw == "LOOP LDAA 0,X  next entry",
+          "a row view puts its columns back together");
+    Check(branch.referencedLabel.data() == loop.label.data(), "every use of a label shares one interned name");
+
+    buffer.assign(buffer.size(), ' ');
+    Check(rows[3].label == "LOOP", "labels do not point into the source text");
+
+    assembler.Reset();
+    Check(assembler.lines.empty() && assembler.symbols.size() == 0, "Reset drops the rows and symbols");
+
+    assembler.Assemble(SampleProgram);
+    Check(Bytes(assembler) == Bytes(SampleProgram), "an assembler assembles the same again after Reset");
+}
+
+// NOTE: the expected records were worked out by hand from the S19 and Intel HEX specifications
+static void TestImageFormats() {
+    Assembler assembler;
+    assembler.Assemble(std::string(" ORG $C000\n LDAA #$12\n RTS\n ORG $C004\n NOP\n"));
+    const Image image = Image::FromRows(assembler.lines);
+
+    std::ostringstream binary, srecord, intelHex;
+    image.WriteBinary(binary);
+    image.WriteSRecord(srecord, "T", 0xC000);
+    image.WriteIntelHex(intelHex);
+
+    Check(binary.str() == std::string("\x86\x12\x39\xFF\x01"), "a binary image fills gaps with $FF");
+    Check(srecord.str() == "S004000054A7\nS106C00086123968\nS104C0040136\nS903C0003C\n",
+          "S19 output has a header, one record per segment and the entry point");
+    Check(intelHex.str() == ":03C000008612396C\n:01C00400013A\n:00000001FF\n",
+          "Intel HEX output has one record per segment and an end of file record");
+
+    std::string nops = " ORG $E000\n";
+    for (i32 i = 0; i < 20; i++)
+        nops.append(" NOP\n");
+
+    std::ostringstream split;
+    assembler.Reset();
+    assembler.Assemble(nops);
+    Image::FromRows(assembler.lines).WriteSRecord(split, "", 0xE000);
+    Check(split.str().find("\nS107E010") != std::string::npos, "records carry at most 16 bytes");
+}
+
+static void TestBatchAssembly() {
+    const std::filesystem::path directory = std::filesystem::temp_directory_path();
+    const std::array<std::string, 3> names = { "m68hc11-batch-a.asm", "m68hc11-batch-b.asm", "m68hc11-batch-c.asm" };
+    const std::array<std::string, 3> sources = { SampleProgram, " NOP\n LDAA #$1FF\n", " ORG $E000\n RTS\n" };
+    std::vector<AssemblyJob> jobs;
+
+    for (sz_t i = 0; i < names.size(); i++) {
+        std::ofstream(directory / names[i], std::ios::binary) << sources[i];
+        jobs.push_back({ names[i], { (directory / names[i]).string() } });
+    }
+
+    // NOTE: the last job stands in for an output file that cannot be written
+    const AssemblyCompleteFn write = [&names](const AssemblyJob &job, const Assembler &) {
+        if (job.name == names[2])
+            throw std::runtime_error("failed to write output");
+    };
+
+    WorkStealingPool pool(2);
+    const std::vector<AssemblyResult> results = AssembleBatch(jobs, pool, write);
+
+    Check(results.size() == 3 && results[0].name == names[0] && results[0].ok() && results[0].bytes == 22,
+          "a batch reports each job in order");
+    Check(results[1].error.starts_with("line 2: "), "an assembly error names its line");
+    Check(results[2].error == "failed to write output", "an output error names no line");
+
+    for (const std::string &name : names)
+        std::filesystem::remove(directory / name);
+}
+
+static bool SameRows(const Assembler &a, const Assembler &b) {
+    if (a.lines.size() != b.lines.size())
+        return false;
+
+    for (sz_t i = 0; i < a.lines.size(); i++) {
+        const Row x = a.lines[i], y = b.lines[i];
+
+        if (x.raw != y.raw || x.line != y.line || x.label != y.label || x.instruction != y.instruction
+            || x.mode != y.mode || x.address != y.address || !std::ranges::equal(x.assembled, y.assembled))
+            return false;
+    }
+
+    return true;
+}
+
+static void TestIncrementalUpdate() {
+    // NOTE: an operand change, a line that moves everything after it, and a removed line that pulls it back
+    const std::array<std::pair<std::string_view, std::string_view>, 3> edits = { {
+        { "LOOP LDAA 0,X", "LOOP LDAA 1,X" },
+        { " INX\n", " INX\n LDAB $1234\n" },
+        { " BEQ DONE\n", "" },
+    } };
+
+    Assembler live;
+    std::string text = SampleProgram;
+    live.Update(text);
+
+    for (sz_t i = 0; i < edits.size(); i++) {
+        const auto &[from, to] = edits[i];
+        text.replace(text.find(from), from.size(), to);
+        const sz_t first = live.Update(text);
+
+        Assembler fresh;
+        fresh.Assemble(text);
+        Check(first > 0, std::format("edit {} leaves the rows before it alone", i + 1));
+        Check(SameRows(live, fresh), std::format("edit {} gives the rows of a fresh assembly", i + 1));
+    }
+}
+
+static void TestForwardReferences() {
+    // NOTE: LATER is used three ways before it is defined, and VAR only gets its address after the code
+    Check(Bytes(" ORG $C000\n"
+                "START JMP LATER\n"
+                " LDX #LATER\n"
+                " LDAA <VAR\n"
+                " BRA LATER\n"
+                " NOP\n"
+                "LATER STAA VAR\n"
+                " BRA START\n"
+                " ORG $0080\n"
+                "VAR RMB 1\n")
+          == "7e c0 0b ce c0 0b 96 80 20 01 01 97 80 20 f1 00",
+          "every use of a symbol is patched once it is defined");
+
+    Assembler assembler;
+    bool thrown = false;
+
+    try {
+        assembler.Assemble(std::string(" ORG $C000\n JMP NOWHERE\n BRA NOWHERE\n"));
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+
+    const std::vector<std::string> &unresolved = assembler.unresolved;
+    Check(thrown && unresolved.size() == 2 && unresolved[0] == "Undefined symbol NOWHERE at line 2"
+          && unresolved[1] == "Undefined symbol NOWHERE at line 3", "each use of an undefined symbol is reported");
+}
+
+static void TestRelaxation() {
+    // NOTE: FAR ends up 221 bytes on, out of reach of a branch, so BEQ becomes BNE over a JMP and BRA and BSR become
+    // JMP and JSR; DATA is past $FF and needs the extended form even though it is not defined yet when first used
+    std::string expected = "26 03 7e c0 dd 7e c0 dd bd c0 dd 26 f3 96 80 b6 12 34 b6 c0 de";
+    for (i32 i = 0; i < 200; i++)
+        expected.append(" 00");
+    expected.append(" 39 00");
+
+    Check(Bytes(" ORG $C000\n"
+                "START BEQ FAR\n"
+                " BRA FAR\n"
+                " BSR FAR\n"
+                " BNE START\n"
+                " LDAA $80\n"
+                " LDAA $1234\n"
+                " LDAA DATA\n"
+                " RMB 200\n"
+                "FAR RTS\n"
+                "DATA RMB 1\n") == expected,
+          "branches out of range are inverted over a jump and operands take the shortest form that fits");
+}
+
+static void TestByteOperandsAreChecked() {
+    for (const char *source : { " LDAA <$1234", " LDAA #$1FF", " LDAA $1FF,X" })
+        Check(Rejected(source), std::format("{} is rejected", source));
+
+    Assembler assembler;
+    assembler.Assemble(std::string(" LDAA <$FF\n LDAA #$FF\n LDAA $FF,X\n"));
+    Check(assembler.lines.size() == 3, "byte operands up to $FF assemble");
+}
+
+int main() {
+    TestMnemonicLookup();
+    TestOpcodeTable();
+    TestLexer();
+    TestChunkedAndMappedInput();
+    TestRowStorage();
+    TestImageFormats();
+    TestBatchAssembly();
+    TestIncrementalUpdate();
+    TestForwardReferences();
+    TestRelaxation();
+    TestByteOperandsAreChecked();
+
+    if (failures > 0) {
+        std::printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    std::printf("all checks passed\n");
+    return 0;
+}
@@ -0,0 +1,73 @@
+#ifndef M68HC11_BATCHASSEMBLER_H
+#define M68HC11_BATCHASSEMBLER_H
+
+#include "assembler.h"
+#include "m68hc11x.h"
+#include "threadpool.h"
+#include <chrono>
+#include <format>
+#include <functional>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// One program to build: its modules are assembled in order into a single assembler context
+struct AssemblyJob {
+    std::string name;
+    std::vector<std::string> sources;
+};
+
+struct AssemblyResult {
+    std::string name;
+    std::string error;
+    sz_t rows = 0;
+    sz_t bytes = 0;
+    std::chrono::nanoseconds elapsed{};
+
+    [[nodiscard]] bool ok() const { return error.empty(); }
+};
+
+// NOTE: called on the worker that assembled the job while its rows are still alive, e.g. to write the images
+using AssemblyCompleteFn = std::function<void(const AssemblyJob &, const Assembler &)>;
+
+inline std::vector<AssemblyResult> AssembleBatch(std::span<const AssemblyJob> jobs, WorkStealingPool &pool,
+                                                 const AssemblyCompleteFn &onAssembled = {}) {
+    std::vector<AssemblyResult> results(jobs.size());
+
+    pool.ParallelFor(jobs.size(), [&](sz_t i) {
+        const auto start = std::chrono::steady_clock::now();
+        const AssemblyJob &job = jobs[i];
+        AssemblyResult &result = results[i];
+        result.name = job.name;
+
+        // NOTE: every job owns its assembler; the only state shared between threads is the constexpr instruction table
+        Assembler assembler;
+
+        try {
+            assembler.AssembleFiles(job.sources);
+        } catch (std::runtime_error &e) {
+            // NOTE: unresolved symbols are reported after the last row and already name their own lines
+            result.error = assembler.lines.empty() || !assembler.unresolved.empty()
+                ? std::string(e.what())
+                : std::format("line {}: {}", assembler.lines.line.back(), e.what());
+        }
+
+        // NOTE: a failure in the callback, such as an unwritable output file, has nothing to do with any source line
+        if (result.ok() && onAssembled) {
+            try {
+                onAssembled(job, assembler);
+            } catch (std::runtime_error &e) {
+                result.error = e.what();
+            }
+        }
+
+        result.rows = assembler.lines.size();
+        result.bytes = assembler.lines.bytes.size();
+        result.elapsed = std::chrono::steady_clock::now() - start;
+    });
+
+    return results;
+}
+
+#endif //M68HC11_BATCHASSEMBLER_H
@@ -0,0 +1,127 @@
+#ifndef M68HC11_BATCHEMULATOR_H
+#define M68HC11_BATCHEMULATOR_H
+
+#include "m68hc11x.h"
+#include "machine.h"
+#include "threadpool.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// One run of the firmware: the input it gets, by default bytes arriving on the SCI receiver
+struct EmulationJob {
+    std::string name;
+    std::vector<u8> input;
+};
+
+struct EmulationResult {
+    std::string name;
+    std::string error;
+    // NOTE: everything the SCI transmitted
+    std::vector<u8> output;
+    u64 instructions = 0;
+    u64 cycles = 0;
+    RunState runState = RunState::Running;
+    std::chrono::nanoseconds elapsed{};
+
+    [[nodiscard]] bool ok() const { return error.empty(); }
+};
+
+struct EmulationReport {
+    std::vector<EmulationResult> results;
+    u64 instructions = 0;
+    std::chrono::nanoseconds elapsed{};
+
+    [[nodiscard]] double InstructionsPerSecond() const {
+        return elapsed.count() > 0 ? instructions * 1e9 / elapsed.count() : 0;
+    }
+};
+
+// NOTE: all optional. configure runs once on every machine the batch creates, for the mapping and the I/O handlers
+// that snapshots leave out; an SCI transmit handler it sets still gets every byte, after the byte is added to the
+// job's output. start runs after the snapshot is restored for a job and queues its input on the SCI when left empty;
+// complete runs on the worker while the machine still holds the job's final state.
+struct EmulationHooks {
+    std::function<void(Machine &)> configure;
+    std::function<void(Machine &, const EmulationJob &)> start;
+    std::function<void(Machine &, const EmulationJob &)> complete;
+};
+
+// Runs every job for duration cycles, or until the firmware stops, on a machine forked from boot. There is one
+// machine per worker, created on the worker itself so its memory is local to it, and jobs are handed out from a shared
+// counter; boot's memory pages are shared by all of them and each job only copies the pages the previous one wrote.
+// A job starts from exactly the same state whichever machine runs it, block cache included, so the results do not
+// depend on the number of threads.
+inline EmulationReport EmulateBatch(const Snapshot &boot, std::span<const EmulationJob> jobs, u64 duration,
+                                    WorkStealingPool &pool, const EmulationHooks &hooks = {}) {
+    const auto start = std::chrono::steady_clock::now();
+    const u16 ramSize = static_cast<u16>((boot.bus.pages.size() - Bus::PageCount) * Bus::PageSize);
+
+    EmulationReport report;
+    report.results.resize(jobs.size());
+
+    std::atomic<sz_t> next = 0;
+    std::atomic<u64> instructions = 0;
+
+    pool.ParallelFor(std::min(pool.size(), jobs.size()), [&](sz_t) {
+        const auto machine = std::make_unique<Machine>(ramSize);
+        EmulationResult *current = nullptr;
+
+        if (hooks.configure)
+            hooks.configure(*machine);
+
+        machine->peripherals.sciTransmit = [&current, chained = std::move(machine->peripherals.sciTransmit)](u8 byte) {
+            current->output.push_back(byte);
+
+            if (chained)
+                chained(byte);
+        };
+
+        for (sz_t i = next++; i < jobs.size(); i = next++) {
+            const auto jobStart = std::chrono::steady_clock::now();
+            const EmulationJob &job = jobs[i];
+            EmulationResult &result = report.results[i];
+            result.name = job.name;
+            current = &result;
+
+            try {
+                machine->Restore(boot);
+
+                // NOTE: blocks left by the previous job would change where this one's blocks start and which of them
+                // are translated, and with them which instruction an interrupt is taken at
+                machine->blocks.Flush();
+
+                if (hooks.start) {
+                    hooks.start(*machine, job);
+                } else {
+                    for (const u8 byte : job.input)
+                        machine->peripherals.SciReceive(byte);
+                }
+
+                result.instructions = machine->Run(duration);
+
+                if (hooks.complete)
+                    hooks.complete(*machine, job);
+            } catch (std::runtime_error &e) {
+                result.error = e.what();
+            }
+
+            result.cycles = machine->cpu.cycles - boot.cycles;
+            result.runState = machine->cpu.runState;
+            result.elapsed = std::chrono::steady_clock::now() - jobStart;
+            instructions += result.instructions;
+        }
+    });
+
+    report.instructions = instructions;
+    report.elapsed = std::chrono::steady_clock::now() - start;
+    return report;
+}
+
+#endif //M68HC11_BATCHEMULATOR_H
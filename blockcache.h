@@ -0,0 +1,353 @@
+#ifndef M68HC11_BLOCKCACHE_H
+#define M68HC11_BLOCKCACHE_H
+
+#include "bus.h"
+#include "cpu.h"
+#include "jit.h"
+#include "m68hc11x.h"
+#include <algorithm>
+#include <array>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+// NOTE: a straight run of instructions ending at the first one that can go anywhere else; blocks are never freed on
+// their own, an invalidated one just stops being found until the whole cache is flushed
+struct Block {
+    u32 first;
+    u32 count;
+    u16 start;
+    bool valid;
+#ifdef M68HC11_JIT_AVAILABLE
+    u32 runs = 0;
+    // NOTE: time spent before the last instruction starts, to tell whether a cycle limit lets the whole block run
+    u32 leadCycles = 0;
+    // NOTE: translated code for cycle accurate and for fast timing, each made the first time it is needed
+    std::array<NativeBlockFn, 2> native {};
+#endif
+};
+
+// Runs a Cpu from guest code translated into blocks of pre-decoded instructions, so a hot loop pays for fetching and
+// decoding once instead of on every pass. Pages holding cached code are watched on the bus; the first write to one
+// drops every block decoded from it. Code that is read through an I/O handler is never cached and runs through
+// Cpu::Step instead.
+//
+// Interrupts are taken between blocks. Anything that raises one in the middle of a block has to pull in Cpu::deadline
+// so the block stops; a translated block always runs to its end first. Breakpoints are checked between blocks as
+// well, and a block never runs into an address that has one, so it always starts a block of its own.
+//
+// Built with M68HC11_JIT on an x86-64 host, a block that has run JitThreshold times is also translated to native code
+// (jit.h), which SetJitEnabled can switch off again, e.g. to debug the interpreter.
+class BlockCache {
+public:
+    static constexpr u32 NoBlock = ~u32(0);
+    static constexpr u32 MaxBlockLength = 64;
+    // NOTE: once this many instructions are cached everything is dropped, which also reclaims invalidated blocks
+    static constexpr sz_t FlushThreshold = 1 << 18;
+    static constexpr u32 JitThreshold = 16;
+
+#ifdef M68HC11_JIT_AVAILABLE
+    static constexpr bool JitAvailable = true;
+#else
+    static constexpr bool JitAvailable = false;
+#endif
+
+    explicit BlockCache(Cpu &cpu) : cpu(cpu), blockAt(0x10000, NoBlock), mapGeneration(cpu.bus.MapGeneration())
+#ifdef M68HC11_JIT_AVAILABLE
+            , jit(cpu)
+#endif
+    {
+        cpu.bus.SetWatchHandler([this](u16 address) { Invalidate(address >> 8); });
+    }
+
+    BlockCache(const BlockCache &) = delete;
+    BlockCache &operator=(const BlockCache &) = delete;
+
+    ~BlockCache() {
+        Flush();
+        cpu.bus.SetWatchHandler(nullptr);
+    }
+
+    // NOTE: same contract as Cpu::Run
+    template<typename Timing = CycleAccurate, typename Trace = NoTrace>
+    u64 Run(u64 count) {
+        u64 executed = 0;
+
+        while (executed < count) {
+            if (cpu.InterruptPending()) [[unlikely]]
+                cpu.ServiceInterrupt<Timing, Trace>();
+
+            if (cpu.runState != RunState::Running || cpu.Halting())
+                break;
+
+            const u32 id = Lookup(cpu.state.PC);
+
+            if (id == NoBlock) {
+                cpu.Step<Timing, Trace>();
+                executed++;
+            } else {
+                executed += Execute<Timing, Trace, false>(blocks[id], count - executed);
+            }
+        }
+
+        return executed;
+    }
+
+    // NOTE: same contract as Cpu::RunUntil
+    template<typename Trace = NoTrace>
+    u64 RunUntil(u64 target) {
+        u64 executed = 0;
+        cpu.deadline = target;
+
+        while (cpu.cycles < cpu.deadline) {
+            if (cpu.InterruptPending()) [[unlikely]]
+                cpu.ServiceInterrupt<CycleAccurate, Trace>();
+
+            if (cpu.runState != RunState::Running || cpu.Halting())
+                break;
+
+            const u32 id = Lookup(cpu.state.PC);
+
+            if (id == NoBlock) {
+                cpu.Step<CycleAccurate, Trace>();
+                executed++;
+            } else {
+                executed += Execute<CycleAccurate, Trace, true>(blocks[id], ~u64(0));
+            }
+        }
+
+        return executed;
+    }
+
+    void Flush() {
+        for (sz_t page = 0; page < pageBlocks.size(); page++) {
+            if (!pageBlocks[page].empty()) {
+                pageBlocks[page].clear();
+                cpu.bus.WatchWrites(page, false);
+            }
+        }
+
+        for (const Block &block : blocks)
+            blockAt[block.start] = NoBlock;
+
+        ops.clear();
+        blocks.clear();
+        invalidations++;
+        mapGeneration = cpu.bus.MapGeneration();
+        flushPending = false;
+
+#ifdef M68HC11_JIT_AVAILABLE
+        jit.Reset();
+#endif
+    }
+
+    // NOTE: drops every block decoded from page, e.g. one that runs past a breakpoint set after it was built
+    void Invalidate(u8 page) {
+        std::vector<u32> &ids = pageBlocks[page];
+
+        for (const u32 id : ids) {
+            Block &block = blocks[id];
+
+            if (block.valid) {
+                block.valid = false;
+                blockAt[block.start] = NoBlock;
+            }
+        }
+
+        ids.clear();
+        cpu.bus.WatchWrites(page, false);
+        invalidations++;
+    }
+
+    // NOTE: makes the running block, translated or not, stop after the current instruction as if that one had written
+    // over it; for a debugger halting the CPU from inside a memory access
+    void StopBlock() {
+        invalidations++;
+    }
+
+    // NOTE: does nothing unless the translator was compiled in
+    void SetJitEnabled(bool enabled) {
+        jitEnabled = enabled && JitAvailable;
+    }
+
+    [[nodiscard]] bool JitEnabled() const { return jitEnabled; }
+
+    [[nodiscard]] sz_t BlockCount() const { return blocks.size(); }
+    [[nodiscard]] sz_t InstructionCount() const { return ops.size(); }
+
+private:
+    template<typename Timing, typename Trace, bool UntilCycle>
+    u64 Execute(Block &block, u64 budget) {
+#ifdef M68HC11_JIT_AVAILABLE
+        // NOTE: translated code has nowhere to record a trace
+        if (!Trace::Enabled && jitEnabled && budget >= block.count
+            && (!UntilCycle || cpu.cycles + block.leadCycles < cpu.deadline)) {
+            if (NativeBlockFn native = Translate<Timing>(block))
+                return native(&cpu, &invalidations);
+        }
+#endif
+
+        const u32 generation = invalidations;
+        const MicroOp *op = &ops[block.first];
+        const MicroOp *end = op + std::min<u64>(block.count, budget);
+        u64 executed = 0;
+
+        for (; op != end; ++op) {
+            if constexpr (UntilCycle) {
+                if (cpu.cycles >= cpu.deadline)
+                    break;
+            }
+
+            u16 ea = op->operand;
+
+            if (op->index == OperandIndex::X)
+                ea += cpu.state.IX;
+            else if (op->index == OperandIndex::Y)
+                ea += cpu.state.IY;
+
+            Trace::Record(cpu);
+            cpu.instructionPC = op->pc;
+            cpu.state.PC = op->next;
+            TimingPolicy<Timing>::Account(cpu.cycles, op->cycles);
+            op->execute(cpu, ea);
+            executed++;
+
+            // NOTE: the instruction wrote over cached code, possibly the rest of this very block
+            if (invalidations != generation)
+                break;
+        }
+
+        return executed;
+    }
+
+    u32 Lookup(u16 pc) {
+        if (cpu.bus.MapGeneration() != mapGeneration || ops.size() >= FlushThreshold || flushPending)
+            Flush();
+
+        const u32 id = blockAt[pc];
+        return id != NoBlock ? id : Build(pc);
+    }
+
+    u32 Build(u16 pc) {
+        const u32 id = static_cast<u32>(blocks.size());
+        Block block = { .first = static_cast<u32>(ops.size()), .count = 0, .start = pc, .valid = true };
+        u16 address = pc;
+
+        while (block.count < MaxBlockLength) {
+            if (block.count > 0 && cpu.breakpoints != nullptr && cpu.breakpoints->Test(address))
+                break;
+
+            // NOTE: decoding reads the opcode, which must not reach a handler or a watchpoint before it runs
+            if (!cpu.bus.IsPlainMemory(address) || !cpu.bus.IsPlainMemory(static_cast<u16>(address + 1)))
+                break;
+
+            u16 cursor = address;
+            const DecodedOp &decoded = Decode(cpu.bus, cursor);
+            const u16 next = cursor + decoded.operandBytes;
+
+            // NOTE: bytes read through a handler can change without a write to notice, so such code is left uncached
+            bool plain = true;
+            for (u16 byte = address; byte != next && plain; byte++)
+                plain = cpu.bus.IsPlainMemory(byte);
+
+            if (!plain)
+                break;
+
+            MicroOp op = { decoded.execute, address, next, 0, OperandIndex::None, decoded.cycles };
+
+            switch (decoded.mode) {
+                case Assembler_AddressingMode::IMMEDIATE:
+                    op.operand = cursor;
+                    break;
+                case Assembler_AddressingMode::DIRECT:
+                    op.operand = cpu.bus.Read(cursor);
+                    break;
+                case Assembler_AddressingMode::EXTENDED:
+                    op.operand = cpu.Read16(cursor);
+                    break;
+                case Assembler_AddressingMode::INDEXED_X:
+                    op.operand = cpu.bus.Read(cursor);
+                    op.index = OperandIndex::X;
+                    break;
+                case Assembler_AddressingMode::INDEXED_Y:
+                    op.operand = cpu.bus.Read(cursor);
+                    op.index = OperandIndex::Y;
+                    break;
+                case Assembler_AddressingMode::RELATIVE:
+                    op.operand = cursor + 1 + static_cast<i8>(cpu.bus.Read(cursor));
+                    break;
+                case Assembler_AddressingMode::INHERENT:
+                    break;
+            }
+
+            ops.push_back(op);
+            block.count++;
+
+            for (u16 byte = address; byte != next; byte++)
+                WatchPage(byte >> 8, id);
+
+            address = next;
+
+            if (decoded.endsBlock)
+                break;
+        }
+
+        if (block.count == 0)
+            return NoBlock;
+
+#ifdef M68HC11_JIT_AVAILABLE
+        for (u32 i = 0; i + 1 < block.count; i++)
+            block.leadCycles += ops[block.first + i].cycles;
+#endif
+
+        blocks.push_back(block);
+        blockAt[pc] = id;
+        return id;
+    }
+
+#ifdef M68HC11_JIT_AVAILABLE
+    template<typename Timing>
+    NativeBlockFn Translate(Block &block) {
+        constexpr bool Accurate = std::is_same_v<Timing, CycleAccurate>;
+        NativeBlockFn &native = block.native[Accurate ? 0 : 1];
+
+        if (!native && ++block.runs >= JitThreshold && !flushPending) {
+            native = jit.Compile(std::span(ops).subspan(block.first, block.count), Accurate);
+
+            // NOTE: the code buffer is full; dropping everything at the next block makes room for what is hot now
+            flushPending = native == nullptr;
+        }
+
+        return native;
+    }
+#endif
+
+    void WatchPage(u8 page, u32 id) {
+        std::vector<u32> &ids = pageBlocks[page];
+
+        if (!ids.empty() && ids.back() == id)
+            return;
+
+        if (ids.empty())
+            cpu.bus.WatchWrites(page, true);
+
+        ids.push_back(id);
+    }
+
+    Cpu &cpu;
+    std::vector<MicroOp> ops;
+    std::vector<Block> blocks;
+    std::vector<u32> blockAt;
+    std::array<std::vector<u32>, Bus::PageCount> pageBlocks;
+    u32 invalidations = 0;
+    u32 mapGeneration;
+    // NOTE: set when the cache has to be dropped before the next block runs
+    bool flushPending = false;
+    bool jitEnabled = JitAvailable;
+
+#ifdef M68HC11_JIT_AVAILABLE
+    JitCompiler jit;
+#endif
+};
+
+#endif //M68HC11_BLOCKCACHE_H
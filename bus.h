@@ -0,0 +1,396 @@
+#ifndef M68HC11_BUS_H
+#define M68HC11_BUS_H
+
+#include "m68hc11x.h"
+#include <algorithm>
+#include <array>
+#include <functional>
+#include <memory>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+// NOTE: handlers get the offset into their region, not the full address
+using IoReadFn = std::function<u8(u16 offset)>;
+using IoWriteFn = std::function<void(u16 offset, u8 value)>;
+using WatchFn = std::function<void(u16 address)>;
+using AccessFn = std::function<void(u16 address, u8 value, bool write)>;
+
+// NOTE: an empty read handler leaves reads of the region as plain memory accesses, an empty write handler drops
+// writes to it
+struct IoRegion {
+    u16 base;
+    u16 size;
+    IoReadFn read;
+    IoWriteFn write;
+};
+
+// The 64 KiB address space the CPU sees, dispatched through a table of 256-byte pages. A page that is plain memory
+// points straight at its bytes, so RAM and ROM accesses are one lookup and one index; only pages holding part of the
+// register block or an I/O region go through callbacks. ROM pages write into a scratch page instead of branching.
+//
+// Save and Restore copy the contents page by page, sharing every page that was not written in between with the
+// previous snapshot. Once the first snapshot is taken, the first write to a page after each Save or Restore goes through
+// the slow path to mark the page dirty, so both only ever copy what changed.
+class Bus {
+public:
+    static constexpr sz_t PageSize = 0x100;
+    static constexpr sz_t PageCount = 0x100;
+    static constexpr u16 RegisterBlockSize = 0x40;
+    static constexpr u16 InitRegister = 0x3D;
+    static constexpr u8 InitReset = 0x01;
+    static constexpr u16 EepromBase = 0xB600;
+    static constexpr u16 EepromSize = 0x200;
+
+    using PageData = std::array<u8, PageSize>;
+
+    // NOTE: external memory pages first, then the on-chip RAM; the I/O callbacks are configuration and stay with the
+    // bus
+    struct State {
+        std::vector<std::shared_ptr<const PageData>> pages;
+        std::array<u8, RegisterBlockSize> registers;
+    };
+
+    // NOTE: ramSize is the on-chip RAM, 256 bytes on the A8 and more on later parts, in whole pages
+    explicit Bus(u16 ramSize = 0x100) : ram(ramSize), dirty(PageCount + ramSize / PageSize, true),
+                                        baseline(dirty.size()) {
+        if (ramSize == 0 || ramSize % PageSize != 0 || ramSize > 0x1000)
+            throw std::runtime_error("On-chip RAM must be a whole number of pages up to 4 KiB");
+
+        registers[InitRegister] = InitReset;
+
+        // NOTE: EEPROM reads like ROM; writes are only accepted through a programming sequence, which a peripheral
+        // model can install with MapIo
+        regions.push_back({ EepromBase, EepromSize, nullptr, nullptr });
+        Remap();
+    }
+
+    // NOTE: the bus is referred to by the page table itself, so it cannot be copied or moved
+    Bus(const Bus &) = delete;
+    Bus &operator=(const Bus &) = delete;
+
+    [[nodiscard]] u8 Read(u16 address) const {
+        const Page &page = pages[address >> 8];
+
+        if (page.read) [[likely]]
+            return page.read[address & 0xFF];
+
+        return SlowRead(address);
+    }
+
+    // NOTE: what is stored underneath address, read without running any handler; for tracing and debuggers
+    [[nodiscard]] u8 Peek(u16 address) const {
+        return pages[address >> 8].memory[address & 0xFF];
+    }
+
+    void Write(u16 address, u8 value) {
+        const Page &page = pages[address >> 8];
+
+        if (page.write) [[likely]] {
+            page.write[address & 0xFF] = value;
+            return;
+        }
+
+        SlowWrite(address, value);
+    }
+
+    // NOTE: stores straight into whatever is mapped underneath, ROM and EEPROM included, and wraps around at the top of
+    // the address space like the CPU's own accesses do
+    void Load(u16 address, std::span<const u8> bytes) {
+        for (const u8 byte : bytes) {
+            const Page &page = pages[address >> 8];
+            page.memory[address & 0xFF] = byte;
+            MarkDirty(page.storage);
+            address++;
+        }
+
+        generation++;
+    }
+
+    void Clear() {
+        std::fill(memory.begin(), memory.end(), 0);
+        std::fill(ram.begin(), ram.end(), 0);
+        std::fill(registers.begin(), registers.end(), 0);
+        registers[InitRegister] = InitReset;
+        std::fill(dirty.begin(), dirty.end(), true);
+        Remap();
+    }
+
+    [[nodiscard]] State Save() {
+        State state = { std::vector<std::shared_ptr<const PageData>>(dirty.size()), registers };
+
+        for (sz_t i = 0; i < dirty.size(); i++) {
+            if (dirty[i] || !baseline[i]) {
+                auto page = std::make_shared<PageData>();
+                std::copy_n(Storage(i), PageSize, page->begin());
+                baseline[i] = std::move(page);
+            }
+
+            state.pages[i] = baseline[i];
+        }
+
+        Protect();
+        return state;
+    }
+
+    // NOTE: the state has to come from a bus with the same amount of RAM. Blocks cached from a page that changes are
+    // dropped through the watch handler, the rest stay valid unless INIT moves things around.
+    void Restore(const State &state) {
+        if (state.pages.size() != dirty.size())
+            throw std::runtime_error("Snapshot was taken with a different amount of on-chip RAM");
+
+        std::vector<bool> copied(dirty.size());
+
+        for (sz_t i = 0; i < dirty.size(); i++) {
+            if (dirty[i] || baseline[i] != state.pages[i]) {
+                std::copy_n(state.pages[i]->begin(), PageSize, Storage(i));
+                baseline[i] = state.pages[i];
+                copied[i] = true;
+            }
+        }
+
+        const bool moved = state.registers[InitRegister] != registers[InitRegister];
+        registers = state.registers;
+        Protect();
+
+        if (moved) {
+            Remap();
+            return;
+        }
+
+        for (sz_t index = 0; index < PageCount; index++) {
+            if (copied[pages[index].storage] && watched[index] && watchHandler)
+                watchHandler(index << 8);
+        }
+    }
+
+    // NOTE: whole pages only; external memory stays writable unless marked here
+    void MapRom(u16 base, u32 size) {
+        for (u32 page = base >> 8; page < PageCount && page << 8 < base + size; page++)
+            readOnly[page] = true;
+
+        Remap();
+    }
+
+    // NOTE: a later region wins where two overlap, the register block wins over all of them
+    void MapIo(IoRegion region) {
+        regions.push_back(std::move(region));
+        Remap();
+    }
+
+    // NOTE: installs the peripheral models behind the register block; INIT itself is always handled by the bus
+    void MapRegisters(IoReadFn read, IoWriteFn write) {
+        registerRead = std::move(read);
+        registerWrite = std::move(write);
+    }
+
+    // NOTE: writes to a watched page still land where they would, but go through the slow path and are reported to
+    // the watch handler afterwards; used to notice code being overwritten
+    void WatchWrites(u8 page, bool watch) {
+        watched[page] = watch;
+        Remap(page);
+    }
+
+    void SetWatchHandler(WatchFn handler) {
+        watchHandler = std::move(handler);
+    }
+
+    // NOTE: reads and writes of a page watched for them go through the slow path and are reported to the access
+    // handler once they are done; for debugger watchpoints, which narrow it down to the exact addresses themselves
+    void WatchAccesses(u8 page, bool reads, bool writes) {
+        readWatched[page] = reads;
+        writeWatched[page] = writes;
+        Remap(page);
+    }
+
+    void SetAccessHandler(AccessFn handler) {
+        accessHandler = std::move(handler);
+    }
+
+    // NOTE: true when reading address never runs a handler, so what it returns only changes through writes
+    [[nodiscard]] bool IsPlainMemory(u16 address) const {
+        return pages[address >> 8].read != nullptr && static_cast<u16>(address - RegisterBase()) >= RegisterBlockSize;
+    }
+
+    // NOTE: bumped whenever the page table is rebuilt or memory is loaded without going through Write, so anything
+    // derived from the mapping or the contents can tell it is stale
+    [[nodiscard]] u32 MapGeneration() const { return generation; }
+
+    [[nodiscard]] u16 RamBase() const { return (registers[InitRegister] & 0xF0) << 8; }
+    [[nodiscard]] u16 RegisterBase() const { return (registers[InitRegister] & 0x0F) << 12; }
+
+private:
+    // NOTE: read or write is null when some of the page needs the slow path; memory is what the page holds underneath
+    // and storage the index of those bytes in a snapshot
+    struct Page {
+        u8 *read;
+        u8 *write;
+        u8 *memory;
+        u16 storage;
+        bool writable;
+    };
+
+    [[nodiscard]] u8 *Storage(sz_t index) {
+        return index < PageCount ? &memory[index << 8] : &ram[(index - PageCount) << 8];
+    }
+
+    void MarkDirty(u16 storage) {
+        if (!dirty[storage]) {
+            dirty[storage] = true;
+
+            for (sz_t index = 0; index < PageCount; index++) {
+                if (pages[index].storage == storage)
+                    Remap(index);
+            }
+        }
+    }
+
+    // NOTE: everything is clean again, and writable pages go through the slow path until their first write
+    void Protect() {
+        std::fill(dirty.begin(), dirty.end(), false);
+        tracking = true;
+
+        for (sz_t index = 0; index < PageCount; index++)
+            Remap(index);
+    }
+
+    // NOTE: INIT moves on-chip RAM and the register block to any 4 KiB boundary, so the mapping only changes when it
+    // or the configuration is written and never costs anything per access
+    void Remap() {
+        for (sz_t index = 0; index < PageCount; index++)
+            Remap(index);
+
+        generation++;
+    }
+
+    void Remap(sz_t index) {
+        const u16 ramBase = RamBase();
+        const u16 registerBase = RegisterBase();
+        const u32 address = index << 8;
+        Page &page = pages[index];
+
+        const bool inRam = address >= ramBase && address < ramBase + ram.size();
+        page.memory = inRam ? &ram[address - ramBase] : &memory[address];
+        page.storage = static_cast<u16>(inRam ? PageCount + ((address - ramBase) >> 8) : index);
+        page.writable = inRam || !readOnly[index];
+        page.read = page.memory;
+        page.write = page.writable ? page.memory : scratch.data();
+
+        if (watched[index] || writeWatched[index] || (tracking && page.writable && !dirty[page.storage]))
+            page.write = nullptr;
+
+        if (readWatched[index])
+            page.read = nullptr;
+
+        if (address == registerBase) {
+            page.read = nullptr;
+            page.write = nullptr;
+            return;
+        }
+
+        for (const IoRegion &region : regions) {
+            if (region.base >= address + PageSize || region.base + region.size <= address)
+                continue;
+
+            if (region.read)
+                page.read = nullptr;
+
+            page.write = nullptr;
+        }
+    }
+
+    // NOTE: the last region mapped over address, if any
+    [[nodiscard]] const IoRegion *FindRegion(u16 address) const {
+        for (auto it = regions.rbegin(); it != regions.rend(); ++it) {
+            if (address >= it->base && address < it->base + it->size)
+                return &*it;
+        }
+
+        return nullptr;
+    }
+
+    [[nodiscard]] u8 SlowRead(u16 address) const {
+        const u8 value = Fetch(address);
+
+        if (readWatched[address >> 8] && accessHandler)
+            accessHandler(address, value, false);
+
+        return value;
+    }
+
+    [[nodiscard]] u8 Fetch(u16 address) const {
+        const u16 offset = address - RegisterBase();
+
+        if (offset < RegisterBlockSize)
+            return registerRead && offset != InitRegister ? registerRead(offset) : registers[offset];
+
+        if (const IoRegion *region = FindRegion(address); region && region->read)
+            return region->read(address - region->base);
+
+        return pages[address >> 8].memory[address & 0xFF];
+    }
+
+    void SlowWrite(u16 address, u8 value) {
+        Store(address, value);
+
+        if (watched[address >> 8] && watchHandler)
+            watchHandler(address);
+
+        if (writeWatched[address >> 8] && accessHandler)
+            accessHandler(address, value, true);
+    }
+
+    void Store(u16 address, u8 value) {
+        const u16 offset = address - RegisterBase();
+
+        if (offset < RegisterBlockSize) {
+            registers[offset] = value;
+
+            // NOTE: the real INIT only takes writes during the first 64 cycles after reset; that protection is left
+            // to whoever drives the bus
+            if (offset == InitRegister)
+                Remap();
+            else if (registerWrite)
+                registerWrite(offset, value);
+
+            return;
+        }
+
+        if (const IoRegion *region = FindRegion(address)) {
+            if (region->write)
+                region->write(address - region->base, value);
+
+            return;
+        }
+
+        if (const Page &page = pages[address >> 8]; page.writable) {
+            page.memory[address & 0xFF] = value;
+            MarkDirty(page.storage);
+        }
+    }
+
+    std::array<Page, PageCount> pages {};
+    std::array<u8, 0x10000> memory {};
+    std::vector<u8> ram;
+    std::array<u8, RegisterBlockSize> registers {};
+    std::array<bool, PageCount> readOnly {};
+    std::array<u8, PageSize> scratch {};
+
+    std::array<bool, PageCount> watched {};
+    std::array<bool, PageCount> readWatched {};
+    std::array<bool, PageCount> writeWatched {};
+    u32 generation = 0;
+
+    // NOTE: indexed by storage page; tracking starts with the first snapshot
+    std::vector<bool> dirty;
+    std::vector<std::shared_ptr<const PageData>> baseline;
+    bool tracking = false;
+
+    std::vector<IoRegion> regions;
+    IoReadFn registerRead;
+    IoWriteFn registerWrite;
+    WatchFn watchHandler;
+    AccessFn accessHandler;
+};
+
+#endif //M68HC11_BUS_H
@@ -0,0 +1,994 @@
+#ifndef M68HC11_CPU_H
+#define M68HC11_CPU_H
+
+#include "addressingmode.h"
+#include "assembler.h"
+#include "bus.h"
+#include "m68hc11x.h"
+#include <algorithm>
+#include <array>
+#include <string_view>
+
+namespace CcrFlags {
+    inline constexpr u8 S = 0x80; // STOP disable
+    inline constexpr u8 X = 0x40; // XIRQ mask
+    inline constexpr u8 H = 0x20; // half carry
+    inline constexpr u8 I = 0x10; // IRQ mask
+    inline constexpr u8 N = 0x08;
+    inline constexpr u8 Z = 0x04;
+    inline constexpr u8 V = 0x02;
+    inline constexpr u8 C = 0x01;
+}
+
+// NOTE: $FFC0-$FFD5 are reserved
+namespace Vectors {
+    inline constexpr u16 Sci = 0xFFD6;
+    inline constexpr u16 Spi = 0xFFD8;
+    inline constexpr u16 PulseAccumulatorInput = 0xFFDA;
+    inline constexpr u16 PulseAccumulatorOverflow = 0xFFDC;
+    inline constexpr u16 TimerOverflow = 0xFFDE;
+    inline constexpr u16 Toc5 = 0xFFE0;
+    inline constexpr u16 Toc4 = 0xFFE2;
+    inline constexpr u16 Toc3 = 0xFFE4;
+    inline constexpr u16 Toc2 = 0xFFE6;
+    inline constexpr u16 Toc1 = 0xFFE8;
+    inline constexpr u16 Tic3 = 0xFFEA;
+    inline constexpr u16 Tic2 = 0xFFEC;
+    inline constexpr u16 Tic1 = 0xFFEE;
+    inline constexpr u16 RealTime = 0xFFF0;
+    inline constexpr u16 Irq = 0xFFF2;
+    inline constexpr u16 Xirq = 0xFFF4;
+    inline constexpr u16 Swi = 0xFFF6;
+    inline constexpr u16 IllegalOpcode = 0xFFF8;
+    inline constexpr u16 CopFailure = 0xFFFA;
+    inline constexpr u16 ClockMonitor = 0xFFFC;
+    inline constexpr u16 Reset = 0xFFFE;
+}
+
+// NOTE: the last operation that set N, Z and V; their values are worked out from its operands and result only when
+// something reads them. Everything past Logic8 operates on 16 bits.
+enum class FlagOp : u8 {
+    None,
+    Logic8,
+    Add8,
+    Sub8,
+    Inc8,
+    Dec8,
+    Neg8,
+    Shift8,
+    Logic16,
+    Add16,
+    Sub16,
+    Shift16
+};
+
+// The register file. A and B overlay D with A as the high byte whatever the host byte order, and the condition codes
+// are kept lazily: S X H I and C are always current in ccr, while N Z V are only there once flagOp is None.
+struct alignas(64) CPUState {
+    // NOTE: anonymous structs in a union are an extension every supported compiler accepts, and all of them define
+    // reading a different member than was last written
+    union {
+        u16 D;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        struct {
+            u8 A;
+            u8 B;
+        };
+#else
+        struct {
+            u8 B;
+            u8 A;
+        };
+#endif
+    };
+
+    u16 IX;
+    u16 IY;
+    u16 SP;
+    u16 PC;
+    u8 ccr;
+    FlagOp flagOp;
+
+    // NOTE: 8-bit results are stored zero extended, so Z is always a compare against 0; Shift ops keep their carry out
+    // in flagRight
+    u16 flagLeft;
+    u16 flagRight;
+    u16 flagResult;
+
+    [[nodiscard]] u16 SignBit() const { return flagOp >= FlagOp::Logic16 ? 0x8000 : 0x80; }
+
+    [[nodiscard]] bool Negative() const {
+        return flagOp == FlagOp::None ? ccr & CcrFlags::N : flagResult & SignBit();
+    }
+
+    [[nodiscard]] bool Zero() const {
+        return flagOp == FlagOp::None ? ccr & CcrFlags::Z : flagResult == 0;
+    }
+
+    [[nodiscard]] bool Overflow() const {
+        const u16 sign = SignBit();
+
+        switch (flagOp) {
+            case FlagOp::None:
+                return ccr & CcrFlags::V;
+            case FlagOp::Logic8:
+            case FlagOp::Logic16:
+                return false;
+            case FlagOp::Add8:
+            case FlagOp::Add16:
+                return (flagLeft ^ flagResult) & (flagRight ^ flagResult) & sign;
+            case FlagOp::Sub8:
+            case FlagOp::Sub16:
+                return (flagLeft ^ flagRight) & (flagLeft ^ flagResult) & sign;
+            case FlagOp::Inc8:
+                return flagLeft == 0x7F;
+            case FlagOp::Dec8:
+                return flagLeft == 0x80;
+            case FlagOp::Neg8:
+                return flagResult == 0x80;
+            case FlagOp::Shift8:
+            case FlagOp::Shift16:
+                return Negative() != (flagRight != 0);
+        }
+
+        return false;
+    }
+
+    [[nodiscard]] bool Flag(u8 flag) const {
+        switch (flag) {
+            case CcrFlags::N:
+                return Negative();
+            case CcrFlags::Z:
+                return Zero();
+            case CcrFlags::V:
+                return Overflow();
+            default:
+                return ccr & flag;
+        }
+    }
+
+    void SetLazyFlags(FlagOp op, u16 left, u16 right, u16 result) {
+        flagOp = op;
+        flagLeft = left;
+        flagRight = right;
+        flagResult = result;
+    }
+
+    // NOTE: folds N Z V back into ccr, needed before anything sets only some of them
+    void Materialize() {
+        ccr = CCR();
+        flagOp = FlagOp::None;
+    }
+
+    [[nodiscard]] u8 CCR() const {
+        if (flagOp == FlagOp::None)
+            return ccr;
+
+        return (ccr & ~(CcrFlags::N | CcrFlags::Z | CcrFlags::V)) | (Negative() ? CcrFlags::N : 0) |
+               (Zero() ? CcrFlags::Z : 0) | (Overflow() ? CcrFlags::V : 0);
+    }
+
+    void SetCCR(u8 value) {
+        ccr = value;
+        flagOp = FlagOp::None;
+    }
+};
+
+static_assert(sizeof(CPUState) <= 64, "the register file should fit in one cache line");
+
+enum class RunState : u8 {
+    Running,
+    // NOTE: WAI, registers already stacked for the interrupt it waits for
+    Waiting,
+    // NOTE: STOP with the S bit clear
+    Stopped
+};
+
+// Timing policies for Cpu::Step and Cpu::Run. CycleAccurate adds the E-clock cycles of every instruction to
+// Cpu::cycles; Fast leaves the counter alone and compiles the accounting out of the loop.
+struct CycleAccurate {};
+struct Fast {};
+
+template<typename Timing>
+struct TimingPolicy;
+
+template<>
+struct TimingPolicy<CycleAccurate> {
+    static void Account(u64 &cycles, u8 count) { cycles += count; }
+};
+
+template<>
+struct TimingPolicy<Fast> {
+    static void Account(u64 &, u8) {}
+};
+
+class Cpu;
+class TraceBuffer;
+class Profiler;
+
+// NOTE: the trace policy of Cpu::Step and everything that runs it; Record is called before every instruction and
+// Interrupt when an interrupt is about to be taken. NoTrace compiles to nothing, Traced (trace.h) records into
+// Cpu::trace and Profiled (profiler.h) counts into Cpu::profiler.
+struct NoTrace {
+    static constexpr bool Enabled = false;
+
+    static void Record(const Cpu &) {}
+    static void Interrupt(const Cpu &) {}
+};
+
+// One bit per address for a debugger's breakpoints, and whether the debugger has halted the CPU. The run loops only
+// look at it where a block starts, which the block cache makes sure every breakpoint does, so a run without a
+// debugger attached pays for one null check per block and nothing per instruction.
+class Breakpoints {
+public:
+    void Set(u16 address, bool enabled) {
+        u64 &word = bits[address >> 6];
+        const u64 bit = u64(1) << (address & 63);
+
+        if (((word & bit) != 0) == enabled)
+            return;
+
+        word ^= bit;
+        count += enabled ? 1 : -1;
+    }
+
+    void Clear() {
+        bits.fill(0);
+        count = 0;
+    }
+
+    [[nodiscard]] bool Test(u16 address) const { return bits[address >> 6] >> (address & 63) & 1; }
+    [[nodiscard]] sz_t size() const { return count; }
+
+    // NOTE: continues from address, leaving a breakpoint there instead of hitting it again
+    void Resume(u16 address) {
+        halted = false;
+        resumeAt = Test(address) ? address : NoResume;
+    }
+
+    // NOTE: halts on a breakpoint at pc unless it is the one just resumed from
+    [[nodiscard]] bool Halting(u16 pc) {
+        if (!halted && count > 0 && Test(pc)) {
+            if (resumeAt == pc)
+                resumeAt = NoResume;
+            else
+                halted = true;
+        }
+
+        return halted;
+    }
+
+    // NOTE: set by a breakpoint or by the debugger, e.g. from a watchpoint; kept apart from RunState so halting in
+    // the middle of WAI or STOP does not lose the wait
+    bool halted = false;
+
+private:
+    static constexpr u32 NoResume = ~u32(0);
+
+    std::array<u64, 0x10000 / 64> bits {};
+    sz_t count = 0;
+    u32 resumeAt = NoResume;
+};
+
+// NOTE: ea is the effective address of the operand: the operand bytes themselves for immediate mode, the branch
+// target for relative mode and unused for inherent mode
+using ExecuteFn = void (*)(Cpu &, u16 ea);
+
+class Cpu {
+public:
+    explicit Cpu(Bus &bus) : bus(bus) {}
+
+    Cpu(const Cpu &) = delete;
+    Cpu &operator=(const Cpu &) = delete;
+
+    // NOTE: the reset vector comes from the bus, so the image has to be loaded before
+    void Reset() {
+        state = {};
+        state.SetCCR(CcrFlags::S | CcrFlags::X | CcrFlags::I);
+        state.PC = Read16(Vectors::Reset);
+        runState = RunState::Running;
+    }
+
+    template<typename Timing = CycleAccurate, typename Trace = NoTrace>
+    void Step();
+
+    // NOTE: runs until count instructions have executed, the CPU stops on WAI or STOP or a debugger halts it; returns
+    // how many ran. Pending interrupts are taken between instructions, which also ends a wait.
+    template<typename Timing = CycleAccurate, typename Trace = NoTrace>
+    u64 Run(u64 count) {
+        u64 executed = 0;
+
+        while (executed < count) {
+            if (InterruptPending()) [[unlikely]]
+                ServiceInterrupt<Timing, Trace>();
+
+            if (runState != RunState::Running || Halting())
+                break;
+
+            Step<Timing, Trace>();
+            executed++;
+        }
+
+        return executed;
+    }
+
+    // NOTE: runs until cycles reaches target or the CPU stops; the last instruction may overshoot target by a few
+    // cycles, which stay counted so the next call starts from the exact time. Returns early when something pulls in
+    // deadline while it runs.
+    template<typename Trace = NoTrace>
+    u64 RunUntil(u64 target) {
+        u64 executed = 0;
+        deadline = target;
+
+        while (cycles < deadline) {
+            if (InterruptPending()) [[unlikely]]
+                ServiceInterrupt<CycleAccurate, Trace>();
+
+            if (runState != RunState::Running || Halting())
+                break;
+
+            Step<CycleAccurate, Trace>();
+            executed++;
+        }
+
+        return executed;
+    }
+
+    [[nodiscard]] u8 Read8(u16 address) const { return bus.Read(address); }
+
+    [[nodiscard]] u16 Read16(u16 address) const {
+        return bus.Read(address) << 8 | bus.Read(static_cast<u16>(address + 1));
+    }
+
+    void Write8(u16 address, u8 value) { bus.Write(address, value); }
+
+    void Write16(u16 address, u16 value) {
+        bus.Write(address, value >> 8);
+        bus.Write(static_cast<u16>(address + 1), value);
+    }
+
+    void Push8(u8 value) { Write8(state.SP--, value); }
+    [[nodiscard]] u8 Pull8() { return Read8(++state.SP); }
+
+    // NOTE: the low byte goes first, so the word ends up big-endian in memory
+    void Push16(u16 value) {
+        Push8(value);
+        Push8(value >> 8);
+    }
+
+    [[nodiscard]] u16 Pull16() {
+        const u8 high = Pull8();
+        return high << 8 | Pull8();
+    }
+
+    [[nodiscard]] bool Flag(u8 flag) const { return state.Flag(flag); }
+
+    void SetFlag(u8 flag, bool set) {
+        if (flag & (CcrFlags::N | CcrFlags::Z | CcrFlags::V))
+            state.Materialize();
+
+        state.ccr = set ? state.ccr | flag : state.ccr & ~flag;
+    }
+
+    void SetNZ8(u8 value) { state.SetLazyFlags(FlagOp::Logic8, 0, 0, value); }
+    void SetNZ16(u16 value) { state.SetLazyFlags(FlagOp::Logic16, 0, 0, value); }
+
+    // NOTE: loads, stores, transfers and logic operations all set N and Z from the value and clear V
+    u8 Test8(u8 value) {
+        SetNZ8(value);
+        return value;
+    }
+
+    u16 Test16(u16 value) {
+        SetNZ16(value);
+        return value;
+    }
+
+    u8 Add8(u8 a, u8 b, u8 carry) {
+        const u16 result = a + b + carry;
+        const u8 low = result;
+
+        SetFlag(CcrFlags::H, (a ^ b ^ low) & 0x10);
+        SetFlag(CcrFlags::C, result > 0xFF);
+        state.SetLazyFlags(FlagOp::Add8, a, b, low);
+        return low;
+    }
+
+    u8 Sub8(u8 a, u8 b, u8 borrow) {
+        const u8 result = a - b - borrow;
+
+        SetFlag(CcrFlags::C, a < b + borrow);
+        state.SetLazyFlags(FlagOp::Sub8, a, b, result);
+        return result;
+    }
+
+    u16 Add16(u16 a, u16 b) {
+        const u32 result = a + b;
+        const u16 low = result;
+
+        SetFlag(CcrFlags::C, result > 0xFFFF);
+        state.SetLazyFlags(FlagOp::Add16, a, b, low);
+        return low;
+    }
+
+    u16 Sub16(u16 a, u16 b) {
+        const u16 result = a - b;
+
+        SetFlag(CcrFlags::C, a < b);
+        state.SetLazyFlags(FlagOp::Sub16, a, b, result);
+        return result;
+    }
+
+    // NOTE: shifts and rotates set V to N xor C after the operation
+    u8 Shifted8(u8 result, bool carry) {
+        SetFlag(CcrFlags::C, carry);
+        state.SetLazyFlags(FlagOp::Shift8, 0, carry, result);
+        return result;
+    }
+
+    u8 Asl8(u8 value) { return Shifted8(value << 1, value & 0x80); }
+    u8 Asr8(u8 value) { return Shifted8((value >> 1) | (value & 0x80), value & 0x01); }
+    u8 Lsr8(u8 value) { return Shifted8(value >> 1, value & 0x01); }
+    u8 Rol8(u8 value) { return Shifted8((value << 1) | Flag(CcrFlags::C), value & 0x80); }
+    u8 Ror8(u8 value) { return Shifted8((value >> 1) | (Flag(CcrFlags::C) << 7), value & 0x01); }
+
+    u16 Shifted16(u16 result, bool carry) {
+        SetFlag(CcrFlags::C, carry);
+        state.SetLazyFlags(FlagOp::Shift16, 0, carry, result);
+        return result;
+    }
+
+    u8 Neg8(u8 value) {
+        const u8 result = -value;
+
+        SetFlag(CcrFlags::C, result != 0);
+        state.SetLazyFlags(FlagOp::Neg8, value, 0, result);
+        return result;
+    }
+
+    u8 Com8(u8 value) {
+        SetFlag(CcrFlags::C, true);
+        return Test8(~value);
+    }
+
+    u8 Inc8(u8 value) {
+        const u8 result = value + 1;
+        state.SetLazyFlags(FlagOp::Inc8, value, 0, result);
+        return result;
+    }
+
+    u8 Dec8(u8 value) {
+        const u8 result = value - 1;
+        state.SetLazyFlags(FlagOp::Dec8, value, 0, result);
+        return result;
+    }
+
+    u8 Clr8() {
+        SetFlag(CcrFlags::C, false);
+        return Test8(0);
+    }
+
+    void Branch(bool taken, u16 target) {
+        if (taken)
+            state.PC = target;
+    }
+
+    // NOTE: the order every interrupt uses; CCR ends up on top, PC at the bottom
+    void StackRegisters() {
+        Push16(state.PC);
+        Push16(state.IY);
+        Push16(state.IX);
+        Push8(state.A);
+        Push8(state.B);
+        Push8(state.CCR());
+    }
+
+    // NOTE: X can be cleared by RTI or TAP but never set again
+    void SetCCR(u8 value) {
+        state.SetCCR((value & ~CcrFlags::X) | (value & state.ccr & CcrFlags::X));
+    }
+
+    void UnstackRegisters() {
+        SetCCR(Pull8());
+        state.B = Pull8();
+        state.A = Pull8();
+        state.IX = Pull16();
+        state.IY = Pull16();
+        state.PC = Pull16();
+    }
+
+    void Interrupt(u16 vector) {
+        StackRegisters();
+        SetFlag(CcrFlags::I, true);
+        state.PC = Read16(vector);
+    }
+
+    // NOTE: also true for an XIRQ masked by X while stopped, which ends the STOP without being taken
+    [[nodiscard]] bool InterruptPending() const {
+        if (!xirqRequested && irqVector == 0) [[likely]]
+            return false;
+
+        if (Halted())
+            return false;
+
+        return (xirqRequested && (!(state.ccr & CcrFlags::X) || runState == RunState::Stopped))
+               || (irqVector != 0 && !(state.ccr & CcrFlags::I));
+    }
+
+    // NOTE: XIRQ comes before every maskable source. WAI stacked the registers already, so an interrupt ending it only
+    // fetches the vector; STOP only ends on XIRQ or the maskable sources that still work with the clocks stopped.
+    template<typename Timing = CycleAccurate, typename Trace = NoTrace>
+    void ServiceInterrupt() {
+        u16 vector;
+        u8 mask = CcrFlags::I;
+
+        if (xirqRequested && !(state.ccr & CcrFlags::X)) {
+            vector = Vectors::Xirq;
+            mask |= CcrFlags::X;
+        } else if (irqVector != 0 && !(state.ccr & CcrFlags::I)) {
+            vector = irqVector;
+        } else {
+            if (runState == RunState::Stopped)
+                runState = RunState::Running;
+
+            return;
+        }
+
+        Trace::Interrupt(*this);
+
+        // NOTE: running again before stacking, so a watchpoint on the stack can still halt the CPU
+        const bool stacked = runState == RunState::Waiting;
+        runState = RunState::Running;
+
+        if (!stacked)
+            StackRegisters();
+
+        state.ccr |= mask;
+        state.PC = Read16(vector);
+        TimingPolicy<Timing>::Account(cycles, InterruptCycles);
+    }
+
+    // NOTE: true when the run loops have to stop before the instruction at PC
+    [[nodiscard]] bool Halting() {
+        if (breakpoints == nullptr) [[likely]]
+            return false;
+
+        return breakpoints->Halting(state.PC);
+    }
+
+    [[nodiscard]] bool Halted() const { return breakpoints != nullptr && breakpoints->halted; }
+
+    // NOTE: stacking nine bytes and fetching the vector, the same as SWI
+    static constexpr u8 InterruptCycles = 14;
+
+    CPUState state {};
+    Bus &bus;
+    RunState runState = RunState::Running;
+
+    // NOTE: where the instruction being executed starts, including its prefix
+    u16 instructionPC = 0;
+
+    // NOTE: E-clock cycles since construction; Reset does not rewind it, so time keeps moving forward for anything
+    // scheduled against it
+    u64 cycles = 0;
+
+    // NOTE: where the running RunUntil stops; anything that needs the CPU to stop sooner, like an event scheduled
+    // while the batch runs, pulls it in
+    u64 deadline = 0;
+
+    // NOTE: the interrupt lines, driven by whoever models the sources. irqVector is the vector of the highest priority
+    // maskable source requesting service, 0 when none is; both are levels and stay up until the source is cleared.
+    u16 irqVector = 0;
+    bool xirqRequested = false;
+
+    // NOTE: where the Traced and Profiled policies record to; unused otherwise
+    TraceBuffer *trace = nullptr;
+    Profiler *profiler = nullptr;
+
+    // NOTE: set while a debugger is attached
+    Breakpoints *breakpoints = nullptr;
+};
+
+struct InstructionHandler {
+    std::string_view mnemonic;
+    ExecuteFn execute;
+};
+
+// NOTE: what every mnemonic of AllInstructions does, independent of its addressing mode; aliases (ASL/LSL, BCC/BHS,
+// BCS/BLO) share an opcode and are listed under both names
+inline constexpr auto InstructionHandlers = std::to_array<InstructionHandler>({
+        { "ABA",   [](Cpu &cpu, u16) { cpu.state.A = cpu.Add8(cpu.state.A, cpu.state.B, 0); } },
+        { "ABX",   [](Cpu &cpu, u16) { cpu.state.IX += cpu.state.B; } },
+        { "ABY",   [](Cpu &cpu, u16) { cpu.state.IY += cpu.state.B; } },
+        { "ADCA",  [](Cpu &cpu, u16 ea) { cpu.state.A = cpu.Add8(cpu.state.A, cpu.Read8(ea), cpu.Flag(CcrFlags::C)); } },
+        { "ADCB",  [](Cpu &cpu, u16 ea) { cpu.state.B = cpu.Add8(cpu.state.B, cpu.Read8(ea), cpu.Flag(CcrFlags::C)); } },
+        { "ADDA",  [](Cpu &cpu, u16 ea) { cpu.state.A = cpu.Add8(cpu.state.A, cpu.Read8(ea), 0); } },
+        { "ADDB",  [](Cpu &cpu, u16 ea) { cpu.state.B = cpu.Add8(cpu.state.B, cpu.Read8(ea), 0); } },
+        { "ADDD",  [](Cpu &cpu, u16 ea) { cpu.state.D = cpu.Add16(cpu.state.D, cpu.Read16(ea)); } },
+        { "ANDA",  [](Cpu &cpu, u16 ea) { cpu.state.A = cpu.Test8(cpu.state.A & cpu.Read8(ea)); } },
+        { "ANDB",  [](Cpu &cpu, u16 ea) { cpu.state.B = cpu.Test8(cpu.state.B & cpu.Read8(ea)); } },
+        { "ASL",   [](Cpu &cpu, u16 ea) { cpu.Write8(ea, cpu.Asl8(cpu.Read8(ea))); } },
+        { "ASLA",  [](Cpu &cpu, u16) { cpu.state.A = cpu.Asl8(cpu.state.A); } },
+        { "ASLB",  [](Cpu &cpu, u16) { cpu.state.B = cpu.Asl8(cpu.state.B); } },
+        { "ASLD",  [](Cpu &cpu, u16) { cpu.state.D = cpu.Shifted16(cpu.state.D << 1, cpu.state.A & 0x80); } },
+        { "ASR",   [](Cpu &cpu, u16 ea) { cpu.Write8(ea, cpu.Asr8(cpu.Read8(ea))); } },
+        { "ASRA",  [](Cpu &cpu, u16) { cpu.state.A = cpu.Asr8(cpu.state.A); } },
+        { "ASRB",  [](Cpu &cpu, u16) { cpu.state.B = cpu.Asr8(cpu.state.B); } },
+        { "BCC",   [](Cpu &cpu, u16 ea) { cpu.Branch(!cpu.Flag(CcrFlags::C), ea); } },
+        { "BCLR",  [](Cpu &cpu, u16 ea) { cpu.Write8(ea, cpu.Test8(cpu.Read8(ea) & ~cpu.Read8(cpu.state.PC - 1))); } },
+        { "BCS",   [](Cpu &cpu, u16 ea) { cpu.Branch(cpu.Flag(CcrFlags::C), ea); } },
+        { "BEQ",   [](Cpu &cpu, u16 ea) { cpu.Branch(cpu.Flag(CcrFlags::Z), ea); } },
+        { "BGE",   [](Cpu &cpu, u16 ea) { cpu.Branch(cpu.Flag(CcrFlags::N) == cpu.Flag(CcrFlags::V), ea); } },
+        { "BGT",   [](Cpu &cpu, u16 ea) {
+            cpu.Branch(!cpu.Flag(CcrFlags::Z) && cpu.Flag(CcrFlags::N) == cpu.Flag(CcrFlags::V), ea);
+        } },
+        { "BHI",   [](Cpu &cpu, u16 ea) { cpu.Branch(!cpu.Flag(CcrFlags::C) && !cpu.Flag(CcrFlags::Z), ea); } },
+        { "BHS",   [](Cpu &cpu, u16 ea) { cpu.Branch(!cpu.Flag(CcrFlags::C), ea); } },
+        { "BITA",  [](Cpu &cpu, u16 ea) { cpu.Test8(cpu.state.A & cpu.Read8(ea)); } },
+        { "BITB",  [](Cpu &cpu, u16 ea) { cpu.Test8(cpu.state.B & cpu.Read8(ea)); } },
+        { "BLE",   [](Cpu &cpu, u16 ea) {
+            cpu.Branch(cpu.Flag(CcrFlags::Z) || cpu.Flag(CcrFlags::N) != cpu.Flag(CcrFlags::V), ea);
+        } },
+        { "BLO",   [](Cpu &cpu, u16 ea) { cpu.Branch(cpu.Flag(CcrFlags::C), ea); } },
+        { "BLS",   [](Cpu &cpu, u16 ea) { cpu.Branch(cpu.Flag(CcrFlags::C) || cpu.Flag(CcrFlags::Z), ea); } },
+        { "BLT",   [](Cpu &cpu, u16 ea) { cpu.Branch(cpu.Flag(CcrFlags::N) != cpu.Flag(CcrFlags::V), ea); } },
+        { "BMI",   [](Cpu &cpu, u16 ea) { cpu.Branch(cpu.Flag(CcrFlags::N), ea); } },
+        { "BNE",   [](Cpu &cpu, u16 ea) { cpu.Branch(!cpu.Flag(CcrFlags::Z), ea); } },
+        { "BPL",   [](Cpu &cpu, u16 ea) { cpu.Branch(!cpu.Flag(CcrFlags::N), ea); } },
+        { "BRA",   [](Cpu &cpu, u16 ea) { cpu.state.PC = ea; } },
+        // NOTE: the mask and the displacement follow the address operand, so they are the last two bytes
+        { "BRCLR", [](Cpu &cpu, u16 ea) {
+            const u8 mask = cpu.Read8(cpu.state.PC - 2);
+            const i8 offset = static_cast<i8>(cpu.Read8(cpu.state.PC - 1));
+            cpu.Branch((cpu.Read8(ea) & mask) == 0, cpu.state.PC + offset);
+        } },
+        { "BRN",   [](Cpu &, u16) {} },
+        { "BRSET", [](Cpu &cpu, u16 ea) {
+            const u8 mask = cpu.Read8(cpu.state.PC - 2);
+            const i8 offset = static_cast<i8>(cpu.Read8(cpu.state.PC - 1));
+            cpu.Branch((~cpu.Read8(ea) & mask) == 0, cpu.state.PC + offset);
+        } },
+        { "BSET",  [](Cpu &cpu, u16 ea) { cpu.Write8(ea, cpu.Test8(cpu.Read8(ea) | cpu.Read8(cpu.state.PC - 1))); } },
+        { "BSR",   [](Cpu &cpu, u16 ea) {
+            cpu.Push16(cpu.state.PC);
+            cpu.state.PC = ea;
+        } },
+        { "BVC",   [](Cpu &cpu, u16 ea) { cpu.Branch(!cpu.Flag(CcrFlags::V), ea); } },
+        { "BVS",   [](Cpu &cpu, u16 ea) { cpu.Branch(cpu.Flag(CcrFlags::V), ea); } },
+        { "CBA",   [](Cpu &cpu, u16) { cpu.Sub8(cpu.state.A, cpu.state.B, 0); } },
+        { "CLC",   [](Cpu &cpu, u16) { cpu.SetFlag(CcrFlags::C, false); } },
+        { "CLI",   [](Cpu &cpu, u16) { cpu.SetFlag(CcrFlags::I, false); } },
+        { "CLR",   [](Cpu &cpu, u16 ea) { cpu.Write8(ea, cpu.Clr8()); } },
+        { "CLRA",  [](Cpu &cpu, u16) { cpu.state.A = cpu.Clr8(); } },
+        { "CLRB",  [](Cpu &cpu, u16) { cpu.state.B = cpu.Clr8(); } },
+        { "CLV",   [](Cpu &cpu, u16) { cpu.SetFlag(CcrFlags::V, false); } },
+        { "CMPA",  [](Cpu &cpu, u16 ea) { cpu.Sub8(cpu.state.A, cpu.Read8(ea), 0); } },
+        { "CMPB",  [](Cpu &cpu, u16 ea) { cpu.Sub8(cpu.state.B, cpu.Read8(ea), 0); } },
+        { "COM",   [](Cpu &cpu, u16 ea) { cpu.Write8(ea, cpu.Com8(cpu.Read8(ea))); } },
+        { "COMA",  [](Cpu &cpu, u16) { cpu.state.A = cpu.Com8(cpu.state.A); } },
+        { "COMB",  [](Cpu &cpu, u16) { cpu.state.B = cpu.Com8(cpu.state.B); } },
+        { "CPD",   [](Cpu &cpu, u16 ea) { cpu.Sub16(cpu.state.D, cpu.Read16(ea)); } },
+        { "CPX",   [](Cpu &cpu, u16 ea) { cpu.Sub16(cpu.state.IX, cpu.Read16(ea)); } },
+        { "CPY",   [](Cpu &cpu, u16 ea) { cpu.Sub16(cpu.state.IY, cpu.Read16(ea)); } },
+        { "DAA",   [](Cpu &cpu, u16) {
+            const u8 a = cpu.state.A;
+            u8 correction = 0;
+            bool carry = cpu.Flag(CcrFlags::C);
+
+            if (cpu.Flag(CcrFlags::H) || (a & 0x0F) > 9)
+                correction |= 0x06;
+
+            if (carry || a > 0x99) {
+                correction |= 0x60;
+                carry = true;
+            }
+
+            cpu.state.A = a + correction;
+            cpu.SetNZ8(cpu.state.A);
+            cpu.SetFlag(CcrFlags::C, carry);
+        } },
+        { "DEC",   [](Cpu &cpu, u16 ea) { cpu.Write8(ea, cpu.Dec8(cpu.Read8(ea))); } },
+        { "DECA",  [](Cpu &cpu, u16) { cpu.state.A = cpu.Dec8(cpu.state.A); } },
+        { "DECB",  [](Cpu &cpu, u16) { cpu.state.B = cpu.Dec8(cpu.state.B); } },
+        { "DES",   [](Cpu &cpu, u16) { cpu.state.SP--; } },
+        { "DEX",   [](Cpu &cpu, u16) { cpu.SetFlag(CcrFlags::Z, --cpu.state.IX == 0); } },
+        { "DEY",   [](Cpu &cpu, u16) { cpu.SetFlag(CcrFlags::Z, --cpu.state.IY == 0); } },
+        { "EORA",  [](Cpu &cpu, u16 ea) { cpu.state.A = cpu.Test8(cpu.state.A ^ cpu.Read8(ea)); } },
+        { "EORB",  [](Cpu &cpu, u16 ea) { cpu.state.B = cpu.Test8(cpu.state.B ^ cpu.Read8(ea)); } },
+        // NOTE: D / X as a binary fraction; the quotient goes to X and the remainder to D
+        { "FDIV",  [](Cpu &cpu, u16) {
+            const u16 numerator = cpu.state.D;
+            const u16 denominator = cpu.state.IX;
+
+            cpu.SetFlag(CcrFlags::C, denominator == 0);
+            cpu.SetFlag(CcrFlags::V, denominator <= numerator);
+
+            if (denominator <= numerator) {
+                cpu.state.IX = 0xFFFF;
+            } else {
+                const u32 dividend = static_cast<u32>(numerator) << 16;
+                cpu.state.IX = dividend / denominator;
+                cpu.state.D = dividend % denominator;
+            }
+
+            cpu.SetFlag(CcrFlags::Z, cpu.state.IX == 0);
+        } },
+        { "IDIV",  [](Cpu &cpu, u16) {
+            const u16 numerator = cpu.state.D;
+            const u16 denominator = cpu.state.IX;
+
+            cpu.SetFlag(CcrFlags::C, denominator == 0);
+            cpu.SetFlag(CcrFlags::V, false);
+
+            if (denominator == 0) {
+                cpu.state.IX = 0xFFFF;
+            } else {
+                cpu.state.IX = numerator / denominator;
+                cpu.state.D = numerator % denominator;
+            }
+
+            cpu.SetFlag(CcrFlags::Z, cpu.state.IX == 0);
+        } },
+        { "INC",   [](Cpu &cpu, u16 ea) { cpu.Write8(ea, cpu.Inc8(cpu.Read8(ea))); } },
+        { "INCA",  [](Cpu &cpu, u16) { cpu.state.A = cpu.Inc8(cpu.state.A); } },
+        { "INCB",  [](Cpu &cpu, u16) { cpu.state.B = cpu.Inc8(cpu.state.B); } },
+        { "INS",   [](Cpu &cpu, u16) { cpu.state.SP++; } },
+        { "INX",   [](Cpu &cpu, u16) { cpu.SetFlag(CcrFlags::Z, ++cpu.state.IX == 0); } },
+        { "INY",   [](Cpu &cpu, u16) { cpu.SetFlag(CcrFlags::Z, ++cpu.state.IY == 0); } },
+        { "JMP",   [](Cpu &cpu, u16 ea) { cpu.state.PC = ea; } },
+        { "JSR",   [](Cpu &cpu, u16 ea) {
+            cpu.Push16(cpu.state.PC);
+            cpu.state.PC = ea;
+        } },
+        { "LDAA",  [](Cpu &cpu, u16 ea) { cpu.state.A = cpu.Test8(cpu.Read8(ea)); } },
+        { "LDAB",  [](Cpu &cpu, u16 ea) { cpu.state.B = cpu.Test8(cpu.Read8(ea)); } },
+        { "LDD",   [](Cpu &cpu, u16 ea) { cpu.state.D = cpu.Test16(cpu.Read16(ea)); } },
+        { "LDS",   [](Cpu &cpu, u16 ea) { cpu.state.SP = cpu.Test16(cpu.Read16(ea)); } },
+        { "LDX",   [](Cpu &cpu, u16 ea) { cpu.state.IX = cpu.Test16(cpu.Read16(ea)); } },
+        { "LDY",   [](Cpu &cpu, u16 ea) { cpu.state.IY = cpu.Test16(cpu.Read16(ea)); } },
+        { "LSL",   [](Cpu &cpu, u16 ea) { cpu.Write8(ea, cpu.Asl8(cpu.Read8(ea))); } },
+        { "LSLA",  [](Cpu &cpu, u16) { cpu.state.A = cpu.Asl8(cpu.state.A); } },
+        { "LSLB",  [](Cpu &cpu, u16) { cpu.state.B = cpu.Asl8(cpu.state.B); } },
+        { "LSLD",  [](Cpu &cpu, u16) { cpu.state.D = cpu.Shifted16(cpu.state.D << 1, cpu.state.A & 0x80); } },
+        { "LSR",   [](Cpu &cpu, u16 ea) { cpu.Write8(ea, cpu.Lsr8(cpu.Read8(ea))); } },
+        { "LSRA",  [](Cpu &cpu, u16) { cpu.state.A = cpu.Lsr8(cpu.state.A); } },
+        { "LSRB",  [](Cpu &cpu, u16) { cpu.state.B = cpu.Lsr8(cpu.state.B); } },
+        { "LSRD",  [](Cpu &cpu, u16) { cpu.state.D = cpu.Shifted16(cpu.state.D >> 1, cpu.state.B & 0x01); } },
+        { "MUL",   [](Cpu &cpu, u16) {
+            cpu.state.D = cpu.state.A * cpu.state.B;
+            cpu.SetFlag(CcrFlags::C, cpu.state.B & 0x80);
+        } },
+        { "NEG",   [](Cpu &cpu, u16 ea) { cpu.Write8(ea, cpu.Neg8(cpu.Read8(ea))); } },
+        { "NEGA",  [](Cpu &cpu, u16) { cpu.state.A = cpu.Neg8(cpu.state.A); } },
+        { "NEGB",  [](Cpu &cpu, u16) { cpu.state.B = cpu.Neg8(cpu.state.B); } },
+        { "NOP",   [](Cpu &, u16) {} },
+        { "ORAA",  [](Cpu &cpu, u16 ea) { cpu.state.A = cpu.Test8(cpu.state.A | cpu.Read8(ea)); } },
+        { "ORAB",  [](Cpu &cpu, u16 ea) { cpu.state.B = cpu.Test8(cpu.state.B | cpu.Read8(ea)); } },
+        { "PSHA",  [](Cpu &cpu, u16) { cpu.Push8(cpu.state.A); } },
+        { "PSHB",  [](Cpu &cpu, u16) { cpu.Push8(cpu.state.B); } },
+        { "PSHX",  [](Cpu &cpu, u16) { cpu.Push16(cpu.state.IX); } },
+        { "PSHY",  [](Cpu &cpu, u16) { cpu.Push16(cpu.state.IY); } },
+        { "PULA",  [](Cpu &cpu, u16) { cpu.state.A = cpu.Pull8(); } },
+        { "PULB",  [](Cpu &cpu, u16) { cpu.state.B = cpu.Pull8(); } },
+        { "PULX",  [](Cpu &cpu, u16) { cpu.state.IX = cpu.Pull16(); } },
+        { "PULY",  [](Cpu &cpu, u16) { cpu.state.IY = cpu.Pull16(); } },
+        { "ROL",   [](Cpu &cpu, u16 ea) { cpu.Write8(ea, cpu.Rol8(cpu.Read8(ea))); } },
+        { "ROLA",  [](Cpu &cpu, u16) { cpu.state.A = cpu.Rol8(cpu.state.A); } },
+        { "ROLB",  [](Cpu &cpu, u16) { cpu.state.B = cpu.Rol8(cpu.state.B); } },
+        { "ROR",   [](Cpu &cpu, u16 ea) { cpu.Write8(ea, cpu.Ror8(cpu.Read8(ea))); } },
+        { "RORA",  [](Cpu &cpu, u16) { cpu.state.A = cpu.Ror8(cpu.state.A); } },
+        { "RORB",  [](Cpu &cpu, u16) { cpu.state.B = cpu.Ror8(cpu.state.B); } },
+        { "RTI",   [](Cpu &cpu, u16) { cpu.UnstackRegisters(); } },
+        { "RTS",   [](Cpu &cpu, u16) { cpu.state.PC = cpu.Pull16(); } },
+        { "SBA",   [](Cpu &cpu, u16) { cpu.state.A = cpu.Sub8(cpu.state.A, cpu.state.B, 0); } },
+        { "SBCA",  [](Cpu &cpu, u16 ea) { cpu.state.A = cpu.Sub8(cpu.state.A, cpu.Read8(ea), cpu.Flag(CcrFlags::C)); } },
+        { "SBCB",  [](Cpu &cpu, u16 ea) { cpu.state.B = cpu.Sub8(cpu.state.B, cpu.Read8(ea), cpu.Flag(CcrFlags::C)); } },
+        { "SEC",   [](Cpu &cpu, u16) { cpu.SetFlag(CcrFlags::C, true); } },
+        { "SEI",   [](Cpu &cpu, u16) { cpu.SetFlag(CcrFlags::I, true); } },
+        { "SEV",   [](Cpu &cpu, u16) { cpu.SetFlag(CcrFlags::V, true); } },
+        { "STAA",  [](Cpu &cpu, u16 ea) { cpu.Write8(ea, cpu.Test8(cpu.state.A)); } },
+        { "STAB",  [](Cpu &cpu, u16 ea) { cpu.Write8(ea, cpu.Test8(cpu.state.B)); } },
+        { "STD",   [](Cpu &cpu, u16 ea) { cpu.Write16(ea, cpu.Test16(cpu.state.D)); } },
+        // NOTE: with the S bit set STOP is a NOP
+        { "STOP",  [](Cpu &cpu, u16) {
+            if (!cpu.Flag(CcrFlags::S))
+                cpu.runState = RunState::Stopped;
+        } },
+        { "STS",   [](Cpu &cpu, u16 ea) { cpu.Write16(ea, cpu.Test16(cpu.state.SP)); } },
+        { "STX",   [](Cpu &cpu, u16 ea) { cpu.Write16(ea, cpu.Test16(cpu.state.IX)); } },
+        { "STY",   [](Cpu &cpu, u16 ea) { cpu.Write16(ea, cpu.Test16(cpu.state.IY)); } },
+        { "SUBA",  [](Cpu &cpu, u16 ea) { cpu.state.A = cpu.Sub8(cpu.state.A, cpu.Read8(ea), 0); } },
+        { "SUBB",  [](Cpu &cpu, u16 ea) { cpu.state.B = cpu.Sub8(cpu.state.B, cpu.Read8(ea), 0); } },
+        { "SUBD",  [](Cpu &cpu, u16 ea) { cpu.state.D = cpu.Sub16(cpu.state.D, cpu.Read16(ea)); } },
+        { "SWI",   [](Cpu &cpu, u16) { cpu.Interrupt(Vectors::Swi); } },
+        { "TAB",   [](Cpu &cpu, u16) { cpu.state.B = cpu.Test8(cpu.state.A); } },
+        { "TAP",   [](Cpu &cpu, u16) { cpu.SetCCR(cpu.state.A); } },
+        { "TBA",   [](Cpu &cpu, u16) { cpu.state.A = cpu.Test8(cpu.state.B); } },
+        { "TPA",   [](Cpu &cpu, u16) { cpu.state.A = cpu.state.CCR(); } },
+        { "TST",   [](Cpu &cpu, u16 ea) {
+            cpu.Test8(cpu.Read8(ea));
+            cpu.SetFlag(CcrFlags::C, false);
+        } },
+        { "TSTA",  [](Cpu &cpu, u16) {
+            cpu.Test8(cpu.state.A);
+            cpu.SetFlag(CcrFlags::C, false);
+        } },
+        { "TSTB",  [](Cpu &cpu, u16) {
+            cpu.Test8(cpu.state.B);
+            cpu.SetFlag(CcrFlags::C, false);
+        } },
+        { "TSX",   [](Cpu &cpu, u16) { cpu.state.IX = cpu.state.SP + 1; } },
+        { "TSY",   [](Cpu &cpu, u16) { cpu.state.IY = cpu.state.SP + 1; } },
+        { "TXS",   [](Cpu &cpu, u16) { cpu.state.SP = cpu.state.IX - 1; } },
+        { "TYS",   [](Cpu &cpu, u16) { cpu.state.SP = cpu.state.IY - 1; } },
+        // NOTE: the registers are stacked up front so the interrupt that ends the wait can skip that step
+        { "WAI",   [](Cpu &cpu, u16) {
+            cpu.StackRegisters();
+            cpu.runState = RunState::Waiting;
+        } },
+        { "XGDX",  [](Cpu &cpu, u16) {
+            const u16 d = cpu.state.D;
+            cpu.state.D = cpu.state.IX;
+            cpu.state.IX = d;
+        } },
+        { "XGDY",  [](Cpu &cpu, u16) {
+            const u16 d = cpu.state.D;
+            cpu.state.D = cpu.state.IY;
+            cpu.state.IY = d;
+        } },
+});
+
+// NOTE: opcodes without an instruction (TEST included, it only exists in test mode) trap through the illegal opcode
+// vector with the address of the offending instruction stacked
+inline void IllegalOpcode(Cpu &cpu, u16) {
+    cpu.state.PC = cpu.instructionPC;
+    cpu.Interrupt(Vectors::IllegalOpcode);
+}
+
+// NOTE: the illegal opcode trap stacks the registers and fetches its vector just like SWI
+inline constexpr u8 IllegalOpcodeCycles = 14;
+
+struct DecodedOp {
+    ExecuteFn execute = IllegalOpcode;
+    InstructionRef instruction = nullptr;
+    Assembler_AddressingMode mode = Assembler_AddressingMode::INHERENT;
+    u8 operandBytes = 0;
+    u8 cycles = IllegalOpcodeCycles;
+    // NOTE: set for anything that can move PC somewhere other than the next instruction, or unmask interrupts
+    bool endsBlock = true;
+};
+
+enum class OperandIndex : u8 {
+    None,
+    X,
+    Y
+};
+
+// NOTE: one instruction of a cached block with everything that only depends on its bytes worked out up front;
+// operand is the effective address, or just the offset when an index register has to be added
+struct MicroOp {
+    ExecuteFn execute;
+    u16 pc;
+    u16 next;
+    u16 operand;
+    OperandIndex index;
+    u8 cycles;
+};
+
+// NOTE: the relative mode instructions end a block as well
+inline constexpr auto BlockEndingMnemonics = std::to_array<std::string_view>({
+        "BRCLR", "BRSET", "CLI", "JMP", "JSR", "RTI", "RTS", "STOP", "SWI", "TAP", "WAI"
+});
+
+using DecodePage = std::array<DecodedOp, 256>;
+
+// NOTE: the unprefixed page first, then the pages behind the 0x18, 0x1A and 0xCD prefixes
+inline constexpr std::array<u8, 4> PagePrefixes = { 0x00, 0x18, 0x1A, 0xCD };
+
+consteval std::array<DecodePage, 4> BuildDecodeTables() {
+    std::array<DecodePage, 4> pages {};
+
+    for (const Instruction &instruction : AllInstructions) {
+        const InstructionHandler *handler = nullptr;
+
+        for (const InstructionHandler &candidate : InstructionHandlers) {
+            if (candidate.mnemonic == instruction.mnemonic)
+                handler = &candidate;
+        }
+
+        // NOTE: directives and test mode instructions have no handler
+        if (!handler)
+            continue;
+
+        for (unsigned mode = 0; mode < AddressingModeCount; mode++) {
+            const Operation &operation = instruction.opcodes[mode];
+
+            if (!operation.supported || operation.opcodes.size() == 0)
+                continue;
+
+            const u8 prefix = operation.opcodes.size() == 2 ? *operation.opcodes.begin() : 0x00;
+            const u8 opcode = *(operation.opcodes.end() - 1);
+            const sz_t page = std::find(PagePrefixes.begin(), PagePrefixes.end(), prefix) - PagePrefixes.begin();
+
+            pages[page][opcode] = {
+                handler->execute,
+                &instruction,
+                static_cast<Assembler_AddressingMode>(mode),
+                operation.byteCount,
+                operation.cycles,
+                mode == Assembler_AddressingMode::RELATIVE ||
+                        std::find(BlockEndingMnemonics.begin(), BlockEndingMnemonics.end(), instruction.mnemonic) !=
+                                BlockEndingMnemonics.end()
+            };
+        }
+    }
+
+    return pages;
+}
+
+inline constexpr std::array<DecodePage, 4> DecodeTables = BuildDecodeTables();
+
+// NOTE: moves pc past the prefix and opcode of the instruction at pc, leaving it on the operand bytes
+inline const DecodedOp &Decode(const Bus &bus, u16 &pc) {
+    u8 opcode = bus.Read(pc++);
+    const DecodePage *page = &DecodeTables[0];
+
+    switch (opcode) {
+        case 0x18:
+            page = &DecodeTables[1];
+            opcode = bus.Read(pc++);
+            break;
+        case 0x1A:
+            page = &DecodeTables[2];
+            opcode = bus.Read(pc++);
+            break;
+        case 0xCD:
+            page = &DecodeTables[3];
+            opcode = bus.Read(pc++);
+            break;
+    }
+
+    return (*page)[opcode];
+}
+
+template<typename Timing, typename Trace>
+void Cpu::Step() {
+    Trace::Record(*this);
+
+    u16 pc = state.PC;
+    instructionPC = pc;
+
+    const DecodedOp &op = Decode(bus, pc);
+    u16 ea = 0;
+
+    // NOTE: only the first operand bytes form the address; BSET/BCLR/BRSET/BRCLR read their mask and displacement
+    // back from the end of the instruction
+    switch (op.mode) {
+        case Assembler_AddressingMode::IMMEDIATE:
+            ea = pc;
+            break;
+        case Assembler_AddressingMode::DIRECT:
+            ea = bus.Read(pc);
+            break;
+        case Assembler_AddressingMode::EXTENDED:
+            ea = Read16(pc);
+            break;
+        case Assembler_AddressingMode::INDEXED_X:
+            ea = state.IX + bus.Read(pc);
+            break;
+        case Assembler_AddressingMode::INDEXED_Y:
+            ea = state.IY + bus.Read(pc);
+            break;
+        case Assembler_AddressingMode::RELATIVE:
+            ea = pc + 1 + static_cast<i8>(bus.Read(pc));
+            break;
+        case Assembler_AddressingMode::INHERENT:
+            break;
+    }
+
+    state.PC = pc + op.operandBytes;
+    TimingPolicy<Timing>::Account(cycles, op.cycles);
+    op.execute(*this, ea);
+}
+
+#endif //M68HC11_CPU_H
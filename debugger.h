@@ -0,0 +1,367 @@
+#ifndef M68HC11_DEBUGGER_H
+#define M68HC11_DEBUGGER_H
+
+#include "bus.h"
+#include "cpu.h"
+#include "m68hc11x.h"
+#include "machine.h"
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+// NOTE: size bytes from address, wrapping around at the top of the address space
+struct Watchpoint {
+    u16 address;
+    u16 size;
+    bool reads;
+    bool writes;
+};
+
+// NOTE: why the CPU halted; a watchpoint is hit by the instruction starting at pc, which has completed by then
+struct DebugStop {
+    enum class Reason : u8 {
+        Breakpoint,
+        Read,
+        Write
+    };
+
+    Reason reason;
+    u16 pc;
+    u16 address;
+    u8 value;
+};
+
+// Breakpoints and watchpoints on a Machine, costing nothing on the code and memory they are not set on. Breakpoints
+// live in a bitmap the run loops consult where a block starts, and the block cache ends every block in front of one.
+// Watchpoints take their pages off the bus's fast path, so only accesses to those pages are checked against the list;
+// code on a page watched for reads is never cached either, which makes instruction fetches from it count as reads.
+//
+// Everything that reads through Bus::Read triggers a read watchpoint, so a memory view should use Bus::Peek instead.
+// Run and Step continue from a halt, past a breakpoint at PC, and leave the reason for the next halt in LastStop.
+//
+// With a checkpoint interval set, Run also snapshots the machine every so many cycles, and StepBack and ContinueBack
+// go backwards by restoring the closest checkpoint before the target and running forward to it again. Replays only
+// retrace the original run if the machine is left alone in between: anything changed from outside, like queued SCI
+// input, needs a Checkpoint right after, and the SPI and A/D callbacks have to answer the same again. SCI output is
+// not sent twice, the transmit callback is muted during replays.
+class Debugger {
+public:
+    static constexpr sz_t DefaultCheckpointLimit = 256;
+
+    explicit Debugger(Machine &machine) : machine(machine), jitEnabled(machine.blocks.JitEnabled()) {
+        machine.cpu.breakpoints = &breakpoints;
+        machine.bus.SetAccessHandler([this](u16 address, u8 value, bool write) { Access(address, value, write); });
+    }
+
+    Debugger(const Debugger &) = delete;
+    Debugger &operator=(const Debugger &) = delete;
+
+    ~Debugger() {
+        machine.blocks.SetJitEnabled(jitEnabled);
+        ClearWatchpoints();
+        machine.bus.SetAccessHandler(nullptr);
+        machine.cpu.breakpoints = nullptr;
+    }
+
+    void SetBreakpoint(u16 address, bool enabled = true) {
+        // NOTE: a block built before may run straight through address
+        if (enabled && !breakpoints.Test(address))
+            machine.blocks.Invalidate(address >> 8);
+
+        breakpoints.Set(address, enabled);
+    }
+
+    [[nodiscard]] bool HasBreakpoint(u16 address) const { return breakpoints.Test(address); }
+
+    void ClearBreakpoints() {
+        breakpoints.Clear();
+    }
+
+    void AddWatchpoint(const Watchpoint &watchpoint) {
+        watchpoints.push_back(watchpoint);
+        UpdatePages();
+    }
+
+    // NOTE: removes every watchpoint starting at address
+    void RemoveWatchpoint(u16 address) {
+        std::erase_if(watchpoints, [address](const Watchpoint &watchpoint) { return watchpoint.address == address; });
+        UpdatePages();
+    }
+
+    void ClearWatchpoints() {
+        watchpoints.clear();
+        UpdatePages();
+    }
+
+    [[nodiscard]] std::span<const Watchpoint> Watchpoints() const { return watchpoints; }
+
+    // NOTE: like Machine::Run, returning early when the CPU halts
+    u64 Run(u64 duration) {
+        Cpu &cpu = machine.cpu;
+        const u64 end = cpu.cycles + duration;
+        u64 executed = 0;
+
+        Forward();
+
+        while (cpu.cycles < end && !breakpoints.halted && cpu.runState != RunState::Stopped) {
+            u64 until = end;
+
+            if (interval > 0) {
+                if (checkpoints.empty() || cpu.cycles >= checkpoints.back().cycles + interval)
+                    Checkpoint();
+
+                until = std::min(end, checkpoints.back().cycles + interval);
+            }
+
+            executed += machine.Run(until - cpu.cycles);
+        }
+
+        Finish();
+        return executed;
+    }
+
+    // NOTE: one instruction, or the entry into a pending interrupt; a CPU waiting on WAI skips to the next event
+    u64 Step() {
+        Forward();
+        const u64 executed = Advance(Scheduler::Never);
+        Finish();
+        return executed;
+    }
+
+    // NOTE: keeps a checkpoint every interval cycles that Run covers, up to limit of them with the oldest dropped
+    // first; 0 turns reverse execution off. Replays have to take every interrupt exactly where the run did, which
+    // translated code does not promise, so the translator stays off while checkpoints are kept.
+    void SetCheckpointInterval(u64 cycles, sz_t limit = DefaultCheckpointLimit) {
+        interval = cycles;
+        checkpointLimit = std::max<sz_t>(limit, 1);
+        checkpoints.clear();
+        machine.blocks.SetJitEnabled(interval == 0 && jitEnabled);
+
+        if (interval > 0)
+            Checkpoint();
+    }
+
+    // NOTE: the history restarts from here when something changed the machine from outside
+    void Checkpoint() {
+        if (interval == 0)
+            return;
+
+        while (!checkpoints.empty() && checkpoints.back().cycles >= machine.cpu.cycles)
+            checkpoints.pop_back();
+
+        checkpoints.push_back(machine.Save());
+
+        if (checkpoints.size() > checkpointLimit)
+            checkpoints.pop_front();
+    }
+
+    [[nodiscard]] sz_t CheckpointCount() const { return checkpoints.size(); }
+
+    // NOTE: back to where the last Step started; false when that is before the oldest checkpoint
+    bool StepBack() {
+        const u64 now = machine.cpu.cycles;
+        const sz_t index = CheckpointBefore(now);
+
+        if (index == checkpoints.size())
+            return false;
+
+        u64 previous = checkpoints[index].cycles;
+
+        Replaying([&] {
+            // NOTE: a step only ever starts where another one ended, which the first pass finds out
+            machine.Restore(checkpoints[index]);
+
+            while (machine.cpu.cycles < now) {
+                previous = machine.cpu.cycles;
+                Resume();
+
+                if (Advance(now) == 0 && machine.cpu.cycles == previous)
+                    break;
+            }
+
+            machine.Restore(checkpoints[index]);
+            ReplayTo(previous, [](const DebugStop &) {});
+        });
+
+        breakpoints.halted = false;
+        stop.reset();
+        return true;
+    }
+
+    // NOTE: back to the last breakpoint or watchpoint hit before now, searching one checkpoint at a time from the
+    // newest; without one it ends up at the oldest checkpoint and returns false
+    bool ContinueBack() {
+        const u64 now = machine.cpu.cycles;
+
+        for (sz_t index = CheckpointBefore(now); index < checkpoints.size(); index--) {
+            const u64 end = index + 1 < checkpoints.size() ? std::min(now, checkpoints[index + 1].cycles) : now;
+            std::optional<std::pair<u64, DebugStop>> last;
+
+            Replaying([&] {
+                machine.Restore(checkpoints[index]);
+                ReplayTo(end, [&](const DebugStop &hit) {
+                    if (machine.cpu.cycles < now)
+                        last = { machine.cpu.cycles, hit };
+                });
+
+                if (last) {
+                    machine.Restore(checkpoints[index]);
+                    ReplayTo(last->first, [](const DebugStop &) {});
+                }
+            });
+
+            if (last) {
+                breakpoints.Resume(machine.cpu.state.PC);
+                breakpoints.halted = true;
+                stop = last->second;
+                return true;
+            }
+        }
+
+        if (!checkpoints.empty() && checkpoints.front().cycles < now)
+            Replaying([&] { machine.Restore(checkpoints.front()); });
+
+        breakpoints.halted = false;
+        stop.reset();
+        return false;
+    }
+
+    [[nodiscard]] bool Halted() const { return breakpoints.halted; }
+    [[nodiscard]] const std::optional<DebugStop> &LastStop() const { return stop; }
+
+private:
+    void Resume() {
+        breakpoints.Resume(machine.cpu.state.PC);
+        stop.reset();
+    }
+
+    // NOTE: going forward from somewhere history went back to makes the checkpoints after it stale
+    void Forward() {
+        while (!checkpoints.empty() && checkpoints.back().cycles > machine.cpu.cycles)
+            checkpoints.pop_back();
+
+        // NOTE: a replay only leaves a wait at the next event, so a wait cut short by the end of a Run can only be
+        // gone back to from a checkpoint taken right there
+        if (machine.cpu.runState == RunState::Waiting
+            && (checkpoints.empty() || checkpoints.back().cycles != machine.cpu.cycles)) {
+            Checkpoint();
+        }
+
+        Resume();
+    }
+
+    // NOTE: one step the way Machine::Run would take it; while waiting, time moves on to the next event or limit
+    u64 Advance(u64 limit) {
+        Cpu &cpu = machine.cpu;
+
+        if (cpu.runState != RunState::Waiting || cpu.InterruptPending())
+            return machine.Run(1);
+
+        const u64 next = std::min(limit, machine.scheduler.NextTime());
+        return next != Scheduler::Never ? machine.Run(next - cpu.cycles) : 0;
+    }
+
+    // NOTE: the newest checkpoint taken before cycles, or the checkpoint count when there is none
+    [[nodiscard]] sz_t CheckpointBefore(u64 cycles) const {
+        const auto it = std::partition_point(checkpoints.begin(), checkpoints.end(), [cycles](const Snapshot &checkpoint) {
+            return checkpoint.cycles < cycles;
+        });
+        return it == checkpoints.begin() ? checkpoints.size() : static_cast<sz_t>(it - checkpoints.begin() - 1);
+    }
+
+    template<typename Fn>
+    void Replaying(Fn &&fn) {
+        auto transmit = std::exchange(machine.peripherals.sciTransmit, nullptr);
+        fn();
+        machine.peripherals.sciTransmit = std::move(transmit);
+    }
+
+    // NOTE: runs on to target without stopping, passing every breakpoint and watchpoint hit on the way to hit, a
+    // breakpoint right where it starts included
+    template<typename Fn>
+    void ReplayTo(u64 target, Fn &&hit) {
+        Cpu &cpu = machine.cpu;
+
+        if (cpu.runState == RunState::Running && breakpoints.Test(cpu.state.PC))
+            hit(DebugStop { DebugStop::Reason::Breakpoint, cpu.state.PC, cpu.state.PC, 0 });
+
+        while (cpu.cycles < target && cpu.runState != RunState::Stopped) {
+            Resume();
+            machine.Run(target - cpu.cycles);
+
+            if (breakpoints.halted) {
+                Finish();
+                hit(*stop);
+            }
+        }
+    }
+
+    void Finish() {
+        if (breakpoints.halted && !stop) {
+            const u16 pc = machine.cpu.state.PC;
+            stop = { DebugStop::Reason::Breakpoint, pc, pc, 0 };
+        }
+    }
+
+    void Access(u16 address, u8 value, bool write) {
+        if (breakpoints.halted)
+            return;
+
+        for (const Watchpoint &watchpoint : watchpoints) {
+            if (static_cast<u16>(address - watchpoint.address) >= std::max<u16>(watchpoint.size, 1)
+                || !(write ? watchpoint.writes : watchpoint.reads)) {
+                continue;
+            }
+
+            const DebugStop::Reason reason = write ? DebugStop::Reason::Write : DebugStop::Reason::Read;
+            stop = { reason, machine.cpu.instructionPC, address, value };
+            breakpoints.halted = true;
+            machine.blocks.StopBlock();
+            return;
+        }
+    }
+
+    void UpdatePages() {
+        std::array<bool, Bus::PageCount> reads {};
+        std::array<bool, Bus::PageCount> writes {};
+
+        for (const Watchpoint &watchpoint : watchpoints) {
+            const u16 size = std::max<u16>(watchpoint.size, 1);
+
+            for (u32 page = watchpoint.address >> 8; page <= (watchpoint.address + size - 1u) >> 8; page++) {
+                reads[page % Bus::PageCount] |= watchpoint.reads;
+                writes[page % Bus::PageCount] |= watchpoint.writes;
+            }
+        }
+
+        for (sz_t page = 0; page < Bus::PageCount; page++) {
+            // NOTE: cached code would not fetch through the bus any more
+            if (reads[page] && !watchedReads[page])
+                machine.blocks.Invalidate(page);
+
+            if (reads[page] != watchedReads[page] || writes[page] != watchedWrites[page])
+                machine.bus.WatchAccesses(page, reads[page], writes[page]);
+        }
+
+        watchedReads = reads;
+        watchedWrites = writes;
+    }
+
+    Machine &machine;
+    bool jitEnabled;
+    Breakpoints breakpoints;
+    std::vector<Watchpoint> watchpoints;
+    std::array<bool, Bus::PageCount> watchedReads {};
+    std::array<bool, Bus::PageCount> watchedWrites {};
+    std::optional<DebugStop> stop;
+
+    u64 interval = 0;
+    sz_t checkpointLimit = DefaultCheckpointLimit;
+    std::deque<Snapshot> checkpoints;
+};
+
+#endif //M68HC11_DEBUGGER_H
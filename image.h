@@ -0,0 +1,143 @@
+#ifndef M68HC11_IMAGE_H
+#define M68HC11_IMAGE_H
+
+#include "assembler.h"
+#include "m68hc11x.h"
+#include <algorithm>
+#include <format>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct ImageSegment {
+    u16 address;
+    std::vector<u8> bytes;
+
+    [[nodiscard]] u32 End() const { return address + static_cast<u32>(bytes.size()); }
+};
+
+// Memory image produced by an assembly: the emitted bytes grouped into contiguous segments, in address order
+class Image {
+public:
+    static Image FromRows(const RowTable &rows) {
+        Image image;
+
+        for (sz_t i = 0; i < rows.size(); i++) {
+            // NOTE: reserved blocks only move the location counter, they do not put anything in the image
+            if (rows.byteCount[i] == 0 || rows.Instruction(i) == ReservedDirectives::RmbInst)
+                continue;
+
+            const std::span<const u8> bytes = rows.Assembled(i);
+
+            if (image.segments.empty() || image.segments.back().End() != rows.address[i])
+                image.segments.push_back({ rows.address[i], {} });
+
+            image.segments.back().bytes.insert(image.segments.back().bytes.end(), bytes.begin(), bytes.end());
+        }
+
+        std::stable_sort(image.segments.begin(), image.segments.end(), [](const auto &a, const auto &b) {
+            return a.address < b.address;
+        });
+
+        return image;
+    }
+
+    [[nodiscard]] bool empty() const { return segments.empty(); }
+
+    // NOTE: the lowest address through the highest, with gaps filled (0xFF matches erased EPROM)
+    void WriteBinary(std::ostream &out, u8 fill = 0xFF) const {
+        if (segments.empty())
+            return;
+
+        const u32 base = segments.front().address;
+        u32 end = 0;
+        for (const ImageSegment &segment : segments)
+            end = std::max(end, segment.End());
+
+        std::vector<u8> flat(end - base, fill);
+        for (const ImageSegment &segment : segments)
+            std::copy(segment.bytes.begin(), segment.bytes.end(), flat.begin() + (segment.address - base));
+
+        out.write(reinterpret_cast<const char *>(flat.data()), static_cast<std::streamsize>(flat.size()));
+    }
+
+    // NOTE: Motorola S19: an S0 header, S1 data records with 16-bit addresses and an S9 record carrying the entry point
+    void WriteSRecord(std::ostream &out, std::string_view header, u16 entry) const {
+        WriteSRecordLine(out, '0', 0, std::span(reinterpret_cast<const u8 *>(header.data()), header.size()));
+
+        ForEachRecord([&](u16 address, std::span<const u8> data) {
+            WriteSRecordLine(out, '1', address, data);
+        });
+
+        WriteSRecordLine(out, '9', entry, {});
+    }
+
+    // NOTE: Intel HEX with type 00 data records and a type 01 end of file record
+    void WriteIntelHex(std::ostream &out) const {
+        ForEachRecord([&](u16 address, std::span<const u8> data) {
+            WriteIntelHexLine(out, 0x00, address, data);
+        });
+
+        WriteIntelHexLine(out, 0x01, 0, {});
+    }
+
+    std::vector<ImageSegment> segments;
+
+private:
+    static constexpr sz_t RecordSize = 16;
+
+    template<typename Callback>
+    void ForEachRecord(Callback &&callback) const {
+        for (const ImageSegment &segment : segments) {
+            for (sz_t i = 0; i < segment.bytes.size(); i += RecordSize) {
+                const sz_t count = std::min(RecordSize, segment.bytes.size() - i);
+                callback(static_cast<u16>(segment.address + i), std::span(segment.bytes).subspan(i, count));
+            }
+        }
+    }
+
+    static void WriteSRecordLine(std::ostream &out, char type, u16 address, std::span<const u8> data) {
+        // NOTE: the count covers the address, the data and the checksum
+        const u8 count = static_cast<u8>(data.size() + 3);
+        u32 sum = count + (address >> 8) + (address & 0xFF);
+
+        std::string line = std::format("S{}{:02X}{:04X}", type, count, address);
+        for (const u8 byte : data) {
+            line.append(std::format("{:02X}", byte));
+            sum += byte;
+        }
+
+        out << line << std::format("{:02X}", static_cast<u8>(~sum)) << '\n';
+    }
+
+    static void WriteIntelHexLine(std::ostream &out, u8 type, u16 address, std::span<const u8> data) {
+        u32 sum = data.size() + (address >> 8) + (address & 0xFF) + type;
+
+        std::string line = std::format(":{:02X}{:04X}{:02X}", data.size(), address, type);
+        for (const u8 byte : data) {
+            line.append(std::format("{:02X}", byte));
+            sum += byte;
+        }
+
+        out << line << std::format("{:02X}", static_cast<u8>(-sum)) << '\n';
+    }
+};
+
+inline void WriteListing(std::ostream &out, const Assembler &assembler) {
+    for (const Row &row : assembler.lines)
+        out << row.str() << '\n';
+
+    out << "\nSymbols:\n";
+    for (SymbolId id = 0; id < assembler.symbols.size(); id++) {
+        const Symbol &symbol = assembler.symbols[id];
+
+        if (symbol.defined)
+            out << std::format("{:04x}  {}\n", symbol.value, symbol.name);
+        else
+            out << std::format("????  {} (undefined)\n", symbol.name);
+    }
+}
+
+#endif //M68HC11_IMAGE_H
@@ -0,0 +1,308 @@
+#ifndef M68HC11_JIT_H
+#define M68HC11_JIT_H
+
+// NOTE: the translator emits SysV x86-64 code, so it only exists when asked for with M68HC11_JIT and the host can
+// run it; everywhere else the block cache keeps interpreting
+#if defined(M68HC11_JIT) && defined(__x86_64__) && (defined(__linux__) || defined(__APPLE__) || defined(__FreeBSD__))
+#define M68HC11_JIT_AVAILABLE 1
+#endif
+
+#ifdef M68HC11_JIT_AVAILABLE
+
+#include "cpu.h"
+#include "m68hc11x.h"
+#include <cstring>
+#include <initializer_list>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <sys/mman.h>
+#include <vector>
+
+// NOTE: runs a whole translated block and returns how many instructions ran, fewer than the block holds when one of
+// them wrote over cached code and bumped the counter behind invalidations
+using NativeBlockFn = u32 (*)(Cpu *cpu, const u32 *invalidations);
+
+// Translates blocks of pre-decoded instructions into x86-64. Instructions that only move registers around or load
+// an immediate are emitted inline; everything else becomes a direct call to its interpreter handler with the operand
+// address already worked out, which drops the dispatch loop, the operand fetch and the indirect branch per
+// instruction. Code lives in one fixed buffer that is writable only while a block is being emitted.
+class JitCompiler {
+public:
+    static constexpr sz_t BufferSize = 1 << 20;
+
+    explicit JitCompiler(Cpu &cpu) : cpu(cpu) {
+        void *memory = mmap(nullptr, BufferSize, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if (memory == MAP_FAILED)
+            throw std::runtime_error("Cannot map memory for translated code");
+
+        buffer = static_cast<u8 *>(memory);
+    }
+
+    JitCompiler(const JitCompiler &) = delete;
+    JitCompiler &operator=(const JitCompiler &) = delete;
+
+    ~JitCompiler() {
+        munmap(buffer, BufferSize);
+    }
+
+    // NOTE: returns nullptr once the buffer is full, until Reset makes room again
+    NativeBlockFn Compile(std::span<const MicroOp> ops, bool countCycles) {
+        code.clear();
+        EmitBlock(ops, countCycles);
+
+        if (used + code.size() > BufferSize)
+            return nullptr;
+
+        u8 *entry = buffer + used;
+
+        if (mprotect(buffer, BufferSize, PROT_READ | PROT_WRITE) != 0)
+            throw std::runtime_error("Cannot make translated code writable");
+
+        std::memcpy(entry, code.data(), code.size());
+
+        if (mprotect(buffer, BufferSize, PROT_READ | PROT_EXEC) != 0)
+            throw std::runtime_error("Cannot make translated code executable");
+
+        used += code.size();
+        return reinterpret_cast<NativeBlockFn>(entry);
+    }
+
+    // NOTE: every NativeBlockFn handed out so far becomes invalid
+    void Reset() {
+        used = 0;
+    }
+
+private:
+    // NOTE: field displacements from the Cpu the code is compiled for, which rbx points at while a block runs
+    [[nodiscard]] i32 Offset(const void *field) const {
+        return static_cast<i32>(static_cast<const u8 *>(field) - reinterpret_cast<const u8 *>(&cpu));
+    }
+
+    void EmitBlock(std::span<const MicroOp> ops, bool countCycles) {
+        std::vector<sz_t> exits;
+        u32 pendingCycles = 0;
+
+        // push rbx; push r13; push r14; mov rbx, rdi; mov r14, rsi; mov r13d, [r14]
+        Emit({ 0x53, 0x41, 0x55, 0x41, 0x56, 0x48, 0x89, 0xFB, 0x49, 0x89, 0xF6, 0x45, 0x8B, 0x2E });
+
+        for (sz_t i = 0; i < ops.size(); i++) {
+            const MicroOp &op = ops[i];
+            const bool last = i + 1 == ops.size();
+
+            pendingCycles += countCycles ? op.cycles : 0;
+
+            if (EmitInline(op)) {
+                if (last) {
+                    FlushCycles(pendingCycles);
+                    if (!ChangesPC(op))
+                        StoreImm16(Offset(&cpu.state.PC), op.next);
+                }
+
+                continue;
+            }
+
+            // NOTE: a handler sees the same state as under Cpu::Step, time included
+            FlushCycles(pendingCycles);
+            StoreImm16(Offset(&cpu.instructionPC), op.pc);
+            StoreImm16(Offset(&cpu.state.PC), op.next);
+
+            Emit({ 0xBE });
+            Imm32(op.operand);
+
+            if (op.index != OperandIndex::None) {
+                LoadZx16(Offset(op.index == OperandIndex::X ? &cpu.state.IX : &cpu.state.IY));
+                Emit({ 0x01, 0xC6 });
+            }
+
+            // mov rdi, rbx; mov rax, handler; call rax
+            Emit({ 0x48, 0x89, 0xDF, 0x48, 0xB8 });
+            Imm64(reinterpret_cast<u64>(op.execute));
+            Emit({ 0xFF, 0xD0 });
+
+            // mov eax, executed; cmp [r14], r13d; jne epilogue
+            if (!last) {
+                Emit({ 0xB8 });
+                Imm32(static_cast<u32>(i + 1));
+                Emit({ 0x45, 0x39, 0x2E, 0x0F, 0x85 });
+                exits.push_back(code.size());
+                Imm32(0);
+            }
+        }
+
+        Emit({ 0xB8 });
+        Imm32(static_cast<u32>(ops.size()));
+
+        for (const sz_t exit : exits) {
+            const i32 displacement = static_cast<i32>(code.size() - (exit + 4));
+            std::memcpy(&code[exit], &displacement, sizeof(displacement));
+        }
+
+        // pop r14; pop r13; pop rbx; ret
+        Emit({ 0x41, 0x5E, 0x41, 0x5D, 0x5B, 0xC3 });
+    }
+
+    // NOTE: cached code cannot change while its block is alive, so decoding it again gives what the block was built from
+    [[nodiscard]] const DecodedOp &Decoded(const MicroOp &op) const {
+        u16 cursor = op.pc;
+        return Decode(cpu.bus, cursor);
+    }
+
+    [[nodiscard]] std::string_view Mnemonic(const MicroOp &op) const {
+        const DecodedOp &decoded = Decoded(op);
+        return decoded.instruction ? decoded.instruction->mnemonic : std::string_view();
+    }
+
+    [[nodiscard]] bool ChangesPC(const MicroOp &op) const {
+        const std::string_view mnemonic = Mnemonic(op);
+        return mnemonic == "BRA" || mnemonic == "JMP";
+    }
+
+    // NOTE: returns false for anything that has to go through its handler
+    bool EmitInline(const MicroOp &op) {
+        const std::string_view mnemonic = Mnemonic(op);
+        const bool immediate = Decoded(op).mode == Assembler_AddressingMode::IMMEDIATE;
+        CPUState &state = cpu.state;
+
+        if (mnemonic == "NOP" || mnemonic == "BRN")
+            return true;
+
+        if ((mnemonic == "BRA" || mnemonic == "JMP") && op.index == OperandIndex::None) {
+            StoreImm16(Offset(&state.PC), op.operand);
+            return true;
+        }
+
+        if (mnemonic == "ABX" || mnemonic == "ABY") {
+            // movzx eax, byte [B]; add [IX/IY], ax
+            Emit({ 0x0F, 0xB6, 0x83 });
+            Imm32(Offset(&state.B));
+            Emit({ 0x66, 0x01, 0x83 });
+            Imm32(Offset(mnemonic == "ABX" ? &state.IX : &state.IY));
+            return true;
+        }
+
+        if (mnemonic == "INS" || mnemonic == "DES") {
+            // inc / dec word [SP]
+            Emit({ 0x66, 0xFF, static_cast<u8>(mnemonic == "INS" ? 0x83 : 0x8B) });
+            Imm32(Offset(&state.SP));
+            return true;
+        }
+
+        if (mnemonic == "TSX" || mnemonic == "TSY" || mnemonic == "TXS" || mnemonic == "TYS") {
+            const bool fromStack = mnemonic.starts_with("TS");
+            const u16 *index = mnemonic == "TSX" || mnemonic == "TXS" ? &state.IX : &state.IY;
+
+            // movzx eax, [source]; inc / dec eax; mov [target], ax
+            LoadZx16(Offset(fromStack ? &state.SP : index));
+            Emit({ 0xFF, static_cast<u8>(fromStack ? 0xC0 : 0xC8) });
+            StoreAx16(Offset(fromStack ? index : &state.SP));
+            return true;
+        }
+
+        if (mnemonic == "XGDX" || mnemonic == "XGDY") {
+            const i32 index = Offset(mnemonic == "XGDX" ? &state.IX : &state.IY);
+
+            // movzx eax, [D]; movzx ecx, [index]; mov [D], cx; mov [index], ax
+            LoadZx16(Offset(&state.D));
+            Emit({ 0x0F, 0xB7, 0x8B });
+            Imm32(index);
+            Emit({ 0x66, 0x89, 0x8B });
+            Imm32(Offset(&state.D));
+            StoreAx16(index);
+            return true;
+        }
+
+        // NOTE: an immediate operand sits in cached code, so it cannot change for as long as the block is alive
+        if (immediate && (mnemonic == "LDAA" || mnemonic == "LDAB")) {
+            const u8 value = cpu.bus.Read(op.operand);
+
+            StoreImm8(Offset(mnemonic == "LDAA" ? &state.A : &state.B), value);
+            StoreLazyFlags(FlagOp::Logic8, value);
+            return true;
+        }
+
+        if (immediate && (mnemonic == "LDD" || mnemonic == "LDX" || mnemonic == "LDY" || mnemonic == "LDS")) {
+            const u16 value = cpu.Read16(op.operand);
+            const u16 *target = mnemonic == "LDD" ? &state.D : mnemonic == "LDX" ? &state.IX
+                              : mnemonic == "LDY" ? &state.IY : &state.SP;
+
+            StoreImm16(Offset(target), value);
+            StoreLazyFlags(FlagOp::Logic16, value);
+            return true;
+        }
+
+        return false;
+    }
+
+    void StoreLazyFlags(FlagOp flagOp, u16 result) {
+        CPUState &state = cpu.state;
+
+        StoreImm8(Offset(&state.flagOp), static_cast<u8>(flagOp));
+        StoreImm16(Offset(&state.flagLeft), 0);
+        StoreImm16(Offset(&state.flagRight), 0);
+        StoreImm16(Offset(&state.flagResult), result);
+    }
+
+    void FlushCycles(u32 &pending) {
+        // add qword [cycles], imm32
+        if (pending > 0) {
+            Emit({ 0x48, 0x81, 0x83 });
+            Imm32(Offset(&cpu.cycles));
+            Imm32(pending);
+        }
+
+        pending = 0;
+    }
+
+    // mov word [rbx + displacement], value
+    void StoreImm16(i32 displacement, u16 value) {
+        Emit({ 0x66, 0xC7, 0x83 });
+        Imm32(displacement);
+        Imm16(value);
+    }
+
+    // mov byte [rbx + displacement], value
+    void StoreImm8(i32 displacement, u8 value) {
+        Emit({ 0xC6, 0x83 });
+        Imm32(displacement);
+        Emit({ value });
+    }
+
+    // movzx eax, word [rbx + displacement]
+    void LoadZx16(i32 displacement) {
+        Emit({ 0x0F, 0xB7, 0x83 });
+        Imm32(displacement);
+    }
+
+    // mov word [rbx + displacement], ax
+    void StoreAx16(i32 displacement) {
+        Emit({ 0x66, 0x89, 0x83 });
+        Imm32(displacement);
+    }
+
+    void Emit(std::initializer_list<u8> bytes) {
+        code.insert(code.end(), bytes);
+    }
+
+    void Imm16(u16 value) { Emit({ static_cast<u8>(value), static_cast<u8>(value >> 8) }); }
+
+    void Imm32(u32 value) {
+        Imm16(value);
+        Imm16(value >> 16);
+    }
+
+    void Imm64(u64 value) {
+        Imm32(value);
+        Imm32(value >> 32);
+    }
+
+    Cpu &cpu;
+    u8 *buffer;
+    sz_t used = 0;
+    std::vector<u8> code;
+};
+
+#endif
+
+#endif //M68HC11_JIT_H
@@ -0,0 +1,125 @@
+#ifndef M68HC11_LEXER_H
+#define M68HC11_LEXER_H
+
+#include "m68hc11x.h"
+#include <array>
+#include <charconv>
+#include <cstring>
+#include <format>
+#include <stdexcept>
+#include <string_view>
+#include <system_error>
+
+struct Token {
+    std::string_view text;
+    u32 line = 0;
+    u32 column = 0;
+
+    [[nodiscard]] bool empty() const { return text.empty(); }
+};
+
+struct SourceLine {
+    // NOTE: label, mnemonic and operand; anything past the third column is a comment
+    static constexpr sz_t MaxTokens = 3;
+
+    std::string_view text;
+    u32 line = 0;
+    std::array<Token, MaxTokens> tokens;
+    u8 tokenCount = 0;
+    std::string_view comment;
+};
+
+// Splits a contiguous source buffer into lines and whitespace separated columns. Every token is a view into the
+// original buffer, so the buffer must outlive anything lexed from it.
+class Lexer {
+public:
+    explicit Lexer(std::string_view source, u32 firstLine = 1) : source(source), lineNumber(firstLine) {}
+
+    bool Next(SourceLine &out) {
+        if (position >= source.size())
+            return false;
+
+        const char *begin = source.data() + position;
+        const void *newline = std::memchr(begin, '\n', source.size() - position);
+        const sz_t length = newline ? static_cast<const char *>(newline) - begin : source.size() - position;
+
+        position += length + 1;
+        out = Tokenize(std::string_view(begin, length), lineNumber++);
+        return true;
+    }
+
+    static SourceLine Tokenize(std::string_view text, u32 line) {
+        if (!text.empty() && text.back() == '\r')
+            text.remove_suffix(1);
+
+        SourceLine out = {};
+        out.text = text;
+        out.line = line;
+
+        sz_t i = 0;
+        while (true) {
+            while (i < text.size() && IsWhitespace(text[i]))
+                i++;
+
+            if (i == text.size())
+                break;
+
+            if (out.tokenCount == SourceLine::MaxTokens) {
+                out.comment = text.substr(i);
+                break;
+            }
+
+            const sz_t start = i;
+            while (i < text.size() && !IsWhitespace(text[i]))
+                i++;
+
+            out.tokens[out.tokenCount++] = { text.substr(start, i - start), line, static_cast<u32>(start + 1) };
+        }
+
+        return out;
+    }
+
+    static bool IsWhitespace(char c) {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+private:
+    std::string_view source;
+    sz_t position = 0;
+    u32 lineNumber;
+};
+
+inline bool IsNumberPrefix(char c) {
+    return c == '$' || c == '%' || (c >= '0' && c <= '9');
+}
+
+// NOTE: parses the leading $hex, %binary or decimal literal of an operand; any suffix (such as ",X") is left for the
+// caller to interpret
+inline u16 ParseNumber(const Token &token, std::string_view text) {
+    int base = 10;
+
+    if (!text.empty() && text.front() == '$') {
+        base = 16;
+        text.remove_prefix(1);
+    } else if (!text.empty() && text.front() == '%') {
+        base = 2;
+        text.remove_prefix(1);
+    }
+
+    u32 value = 0;
+    const auto [end, error] = std::from_chars(text.data(), text.data() + text.size(), value, base);
+
+    if (error == std::errc::invalid_argument)
+        throw std::runtime_error(std::format("Invalid numeric literal at line {}, column {}", token.line, token.column));
+
+    if (error == std::errc::result_out_of_range || value > 0xFFFF)
+        throw std::runtime_error(std::format("Numeric literal out of range at line {}, column {}", token.line, token.column));
+
+    return static_cast<u16>(value);
+}
+
+inline u16 ParseNumber(const Token &token) {
+    return ParseNumber(token, token.text);
+}
+
+#endif //M68HC11_LEXER_H
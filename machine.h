@@ -0,0 +1,91 @@
+#ifndef M68HC11_MACHINE_H
+#define M68HC11_MACHINE_H
+
+#include "blockcache.h"
+#include "bus.h"
+#include "cpu.h"
+#include "m68hc11x.h"
+#include "peripherals.h"
+#include "scheduler.h"
+#include <algorithm>
+
+// NOTE: everything that changes while a machine runs; the block cache is derived from memory and left out. Memory pages
+// are shared with the snapshots taken before, so keeping many of them costs little more than the pages that differ.
+struct Snapshot {
+    CPUState cpu;
+    RunState runState;
+    u64 cycles;
+    bool xirqRequested;
+    Bus::State bus;
+    Scheduler::State scheduler;
+    Peripherals::State peripherals;
+};
+
+// A complete MCU: the bus, the CPU running from the block cache and the peripherals on the register block, with time
+// advanced in batches that end at the next scheduled peripheral event.
+class Machine {
+public:
+    explicit Machine(u16 ramSize = 0x100) : bus(ramSize) {}
+
+    Machine(const Machine &) = delete;
+    Machine &operator=(const Machine &) = delete;
+
+    // NOTE: the image has to be loaded first, the reset vector is fetched from it
+    void Reset() {
+        peripherals.Reset();
+        cpu.Reset();
+    }
+
+    // NOTE: runs for duration E-clock cycles, until the CPU stops or until a debugger halts it, returns how many
+    // instructions executed. While the CPU waits on WAI nothing but an event can wake it, so time skips straight to
+    // the next one; STOP freezes the clocks as well, so only the IRQ or XIRQ pin can end it and Run returns right away.
+    template<typename Trace = NoTrace>
+    u64 Run(u64 duration) {
+        const u64 end = cpu.cycles + duration;
+        u64 executed = 0;
+
+        while (cpu.cycles < end) {
+            if (cpu.InterruptPending())
+                cpu.ServiceInterrupt<CycleAccurate, Trace>();
+
+            if (cpu.runState == RunState::Stopped || cpu.Halted())
+                break;
+
+            const u64 next = std::min(end, scheduler.NextTime());
+
+            if (cpu.runState == RunState::Waiting)
+                cpu.cycles = std::max(cpu.cycles, next);
+            else
+                executed += blocks.RunUntil<Trace>(next);
+
+            scheduler.RunDue(cpu.cycles);
+        }
+
+        return executed;
+    }
+
+    [[nodiscard]] Snapshot Save() {
+        return { cpu.state, cpu.runState, cpu.cycles, cpu.xirqRequested, bus.Save(), scheduler.Save(),
+                 peripherals.Save() };
+    }
+
+    // NOTE: restoring only copies back the memory pages written since the last Save or Restore, or that differ from
+    // the snapshot, so forking many runs from one snapshot takes microseconds each
+    void Restore(const Snapshot &snapshot) {
+        cpu.state = snapshot.cpu;
+        cpu.runState = snapshot.runState;
+        cpu.cycles = snapshot.cycles;
+        cpu.xirqRequested = snapshot.xirqRequested;
+        bus.Restore(snapshot.bus);
+        scheduler.Restore(snapshot.scheduler);
+        peripherals.Restore(snapshot.peripherals);
+    }
+
+    Bus bus;
+    Cpu cpu { bus };
+    Scheduler scheduler { cpu };
+    Peripherals peripherals { bus, cpu, scheduler };
+    BlockCache blocks { cpu };
+};
+
+#endif //M68HC11_MACHINE_H
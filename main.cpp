@@ -11,13 +11,14 @@
 #include <TextEditor.h>
 #include <fstream>
 #include <format>
+#include <string>
+#include <string_view>
+#include <vector>
 
 Assembler assembler;
 
-TextEditor &GetCodeView() {
-    static TextEditor codeView;
-    return codeView;
-}
+// NOTE: why the last assembly failed, shown above the listing
+std::vector<std::string> assemblerMessages;
 
 void WindowAssembler() {
     static TextEditor editor;
@@ -25,32 +26,81 @@ void WindowAssembler() {
     editorSize.y -= 32;
     editor.Render("##assembler", false, editorSize);
 
+    // NOTE: edits made while Live is off are picked up as soon as it is switched back on
+    static bool edited = false;
+    static bool live = true;
+    edited = edited || editor.IsTextChanged();
+
     ImGui::Spacing();
-    if (ImGui::RightAlignedButton("Assemble")) {
-        std::stringstream ss(editor.GetText());
-        assembler.Reset();
+    ImGui::Checkbox("Live", &live);
+    ImGui::SameLine();
 
-        std::vector<std::string> finalLines = {};
+    const bool assemble = ImGui::RightAlignedButton("Assemble");
+    if (!assemble && !(live && edited))
+        return;
 
-        try {
-            assembler.Assemble(ss);
-        } catch (std::runtime_error &e) {
-            finalLines.emplace_back(std::format("Failed to assemble: {}", e.what()));
-        }
+    edited = false;
 
-        for (const Row &row : assembler.lines) {
-            finalLines.push_back(row.str());
-        }
+    if (assemble)
+        assembler.Reset();
+
+    assemblerMessages.clear();
 
-        GetCodeView().SetTextLines(finalLines);
+    try {
+        assembler.Update(editor.GetText());
+    } catch (std::runtime_error &e) {
+        if (assembler.unresolved.empty())
+            assemblerMessages.emplace_back(std::format("Failed to assemble: {}", e.what()));
+
+        for (const std::string &message : assembler.unresolved)
+            assemblerMessages.emplace_back(std::format("Failed to assemble: {}", message));
     }
 }
 
-
+// NOTE: the listing is drawn straight from the assembler's rows and only the rows in view are formatted, so neither
+// scrolling nor assembling again costs more as the program grows. Messages stay outside the table, where they neither
+// scroll away nor shift the clipper's row indices.
 void WindowCodeView() {
-    TextEditor &codeView = GetCodeView();
-    codeView.SetReadOnlyEnabled(true);
-    codeView.Render("##codeview");
+    constexpr ImGuiTableFlags flags = ImGuiTableFlags_ScrollY | ImGuiTableFlags_RowBg | ImGuiTableFlags_BordersInnerV
+                                      | ImGuiTableFlags_Resizable;
+    const RowTable &rows = assembler.lines;
+
+    for (const std::string &message : assemblerMessages)
+        ImGui::TextUnformatted(message.data(), message.data() + message.size());
+
+    if (!ImGui::BeginTable("##listing", 3, flags))
+        return;
+
+    ImGui::TableSetupScrollFreeze(0, 1);
+    ImGui::TableSetupColumn("Address", ImGuiTableColumnFlags_WidthFixed, ImGui::CalcTextSize("0000").x);
+    ImGui::TableSetupColumn("Bytes", ImGuiTableColumnFlags_WidthFixed, ImGui::CalcTextSize("00 00 00 00 00").x);
+    ImGui::TableSetupColumn("Source", ImGuiTableColumnFlags_WidthStretch);
+    ImGui::TableHeadersRow();
+
+    ImGuiListClipper clipper;
+    clipper.Begin(static_cast<i32>(rows.size()));
+    std::string bytes;
+
+    while (clipper.Step()) {
+        for (i32 i = clipper.DisplayStart; i < clipper.DisplayEnd; i++) {
+            const sz_t row = static_cast<sz_t>(i);
+            const std::string_view source = rows.raw[row];
+
+            bytes.clear();
+            for (const u8 byte : rows.Assembled(row))
+                bytes.append(std::format("{:02x} ", byte));
+
+            ImGui::TableNextRow();
+            ImGui::TableSetColumnIndex(0);
+            ImGui::Text("%04x", rows.address[row]);
+            ImGui::TableSetColumnIndex(1);
+            ImGui::TextUnformatted(bytes.data(), bytes.data() + bytes.size());
+            ImGui::TableSetColumnIndex(2);
+            ImGui::TextUnformatted(source.data(), source.data() + source.size());
+        }
+    }
+
+    ImGui::EndTable();
 }
 
 typedef void(*WindowCallback)();
@@ -96,12 +146,15 @@ void SaveTestProgram() {
     std::ofstream testProgram("testProgram.asm");
 
     for (const auto &inst: AllInstructions) {
-        testProgram << " * " << inst->description << " * \n";
+        testProgram << " * " << inst.description << " * \n";
+
+        for (unsigned mode = 0; mode < AddressingModeCount; mode++) {
+            if (!inst.IsAddressingModeSupported(static_cast<Assembler_AddressingMode>(mode)))
+                continue;
 
-        for (const auto &opcodes: inst->opcodes) {
-            testProgram << "\t" << inst->mnemonic << " ";
+            testProgram << "\t" << inst.mnemonic << " ";
 
-            switch (opcodes.first) {
+            switch (mode) {
                 case Assembler_AddressingMode::IMMEDIATE:
                     testProgram << "1";//\t\t// immediate";
                     break;
@@ -142,10 +195,12 @@ void LoadAdditionalFonts() {
     ImGui::GetIO().Fonts->AddFontFromMemoryTTF(fileData.data, fileData.dataSize, m68hc11x::DefaultFontSize * HelloImGui::DpiFontLoadingFactor(), &FontConfig);
 }
 
-int main(i32, char**) {
+int main(i32 argc, char** argv) {
     HelloImGui::RunnerParams params;
 
-    SaveTestProgram();
+    // NOTE: the opcode coverage program is only written on request instead of on every start
+    if (argc > 1 && std::string_view(argv[1]) == "--write-test-program")
+        SaveTestProgram();
 
     params.appWindowParams.windowTitle = m68hc11x::WindowTitle;
 
@@ -0,0 +1,114 @@
+#ifndef M68HC11_MAPPEDFILE_H
+#define M68HC11_MAPPEDFILE_H
+
+#include "m68hc11x.h"
+#include <format>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Read-only memory mapping of a whole file. The contents are paged in on demand by the OS instead of being copied
+// through iostreams, and stay valid for as long as the MappedFile is alive.
+class MappedFile {
+public:
+    MappedFile() = default;
+
+    explicit MappedFile(const std::string &path) {
+#ifdef _WIN32
+        HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            throw std::runtime_error(std::format("Failed to open {}", path));
+
+        LARGE_INTEGER fileSize = {};
+        GetFileSizeEx(file, &fileSize);
+        size = static_cast<sz_t>(fileSize.QuadPart);
+
+        if (size > 0) {
+            HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            data = mapping ? static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0)) : nullptr;
+
+            if (mapping)
+                CloseHandle(mapping);
+        }
+
+        CloseHandle(file);
+#else
+        const int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::runtime_error(std::format("Failed to open {}", path));
+
+        struct stat info = {};
+        fstat(fd, &info);
+        size = static_cast<sz_t>(info.st_size);
+
+        if (size > 0) {
+            void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            data = mapped != MAP_FAILED ? static_cast<const char *>(mapped) : nullptr;
+
+            if (data)
+                madvise(mapped, size, MADV_SEQUENTIAL);
+        }
+
+        close(fd);
+#endif
+
+        if (size > 0 && !data)
+            throw std::runtime_error(std::format("Failed to map {}", path));
+    }
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    MappedFile(MappedFile &&other) noexcept
+        : data(std::exchange(other.data, nullptr)), size(std::exchange(other.size, 0)) {}
+
+    MappedFile &operator=(MappedFile &&other) noexcept {
+        if (this != &other) {
+            Unmap();
+            data = std::exchange(other.data, nullptr);
+            size = std::exchange(other.size, 0);
+        }
+
+        return *this;
+    }
+
+    ~MappedFile() {
+        Unmap();
+    }
+
+    [[nodiscard]] std::span<const char> Contents() const {
+        return { data, size };
+    }
+
+private:
+    void Unmap() {
+        if (!data)
+            return;
+
+#ifdef _WIN32
+        UnmapViewOfFile(data);
+#else
+        munmap(const_cast<char *>(data), size);
+#endif
+        data = nullptr;
+        size = 0;
+    }
+
+    const char *data = nullptr;
+    sz_t size = 0;
+};
+
+#endif //M68HC11_MAPPEDFILE_H
@@ -0,0 +1,508 @@
+#ifndef M68HC11_PERIPHERALS_H
+#define M68HC11_PERIPHERALS_H
+
+#include "bus.h"
+#include "cpu.h"
+#include "m68hc11x.h"
+#include "scheduler.h"
+#include <algorithm>
+#include <array>
+#include <deque>
+#include <functional>
+#include <utility>
+
+// NOTE: offsets into the 64-byte register block
+namespace Registers {
+    inline constexpr u16 PORTA = 0x00;
+    inline constexpr u16 PORTB = 0x04;
+    inline constexpr u16 PORTE = 0x0A;
+    inline constexpr u16 TCNT = 0x0E;
+    inline constexpr u16 TOC1 = 0x16;
+    inline constexpr u16 TOC5 = 0x1E;
+    inline constexpr u16 TMSK1 = 0x22;
+    inline constexpr u16 TFLG1 = 0x23;
+    inline constexpr u16 TMSK2 = 0x24;
+    inline constexpr u16 TFLG2 = 0x25;
+    inline constexpr u16 PACTL = 0x26;
+    inline constexpr u16 SPCR = 0x28;
+    inline constexpr u16 SPSR = 0x29;
+    inline constexpr u16 SPDR = 0x2A;
+    inline constexpr u16 BAUD = 0x2B;
+    inline constexpr u16 SCCR2 = 0x2D;
+    inline constexpr u16 SCSR = 0x2E;
+    inline constexpr u16 SCDR = 0x2F;
+    inline constexpr u16 ADCTL = 0x30;
+    inline constexpr u16 ADR1 = 0x31;
+    inline constexpr u16 OPTION = 0x39;
+    inline constexpr u16 HPRIO = 0x3C;
+}
+
+// Models of the on-chip peripherals behind the register block: the free-running timer with its output compares,
+// overflow and real-time interrupt, the SCI, the SPI master and the A/D converter. Nothing is ticked per instruction.
+// TCNT is worked out from the cycle counter when it is read, and everything that happens at a point in time (a compare
+// match, the end of a transfer or conversion) is an event on the scheduler, so the CPU runs uninterrupted up to the
+// next one. Input captures, the pulse accumulator and the port pins are plain storage.
+//
+// Every flag whose enable bit is set requests an interrupt. The highest priority request, after the one HPRIO
+// promotes, is what the CPU's IRQ line carries; the IRQ and XIRQ pins are driven from outside.
+class Peripherals {
+public:
+    // NOTE: what the outside world sees and provides; all optional
+    std::function<void(u8 byte)> sciTransmit;
+    std::function<u8(u8 out)> spiExchange;
+    std::function<u8(u8 channel)> adcSample;
+
+    // NOTE: everything the models keep between events; their scheduled events are part of the scheduler's state
+    struct State {
+        std::array<u8, Bus::RegisterBlockSize> registers {};
+
+        i64 timerOrigin = 0;
+        u16 tcntLatch = 0;
+        bool tcntLatched = false;
+
+        bool sciShifting = false;
+        bool sciBuffered = false;
+        u8 sciShiftData = 0;
+        u8 sciBufferData = 0;
+        u8 sciReceiveData = 0;
+        std::deque<u8> sciReceived;
+
+        bool spiBusy = false;
+        u8 spiOut = 0;
+
+        bool irqPin = false;
+    };
+
+    Peripherals(Bus &bus, Cpu &cpu, Scheduler &scheduler) : cpu(cpu), scheduler(scheduler) {
+        for (u8 i = 0; i < outputCompares.size(); i++)
+            outputCompares[i] = scheduler.Register([this, i](u64 when) { OutputCompare(i, when); });
+
+        overflowEvent = scheduler.Register([this](u64 when) { Overflow(when); });
+        realTimeEvent = scheduler.Register([this](u64 when) { RealTimeInterrupt(when); });
+        sciTransmitEvent = scheduler.Register([this](u64) { SciTransmitDone(); });
+        sciReceiveEvent = scheduler.Register([this](u64) { SciReceiveDone(); });
+        spiEvent = scheduler.Register([this](u64) { SpiDone(); });
+        adcEvent = scheduler.Register([this](u64) { AdcDone(); });
+
+        bus.MapRegisters([this](u16 offset) { return Read(offset); },
+                         [this](u16 offset, u8 value) { Write(offset, value); });
+        Reset();
+    }
+
+    Peripherals(const Peripherals &) = delete;
+    Peripherals &operator=(const Peripherals &) = delete;
+
+    void Reset() {
+        state.registers = {};
+        state.registers[Registers::SCSR] = ScsrTdre | ScsrTc;
+        state.registers[Registers::HPRIO] = HprioReset;
+
+        for (u16 offset = Registers::TOC1; offset <= Registers::TOC5; offset += 2) {
+            state.registers[offset] = 0xFF;
+            state.registers[offset + 1] = 0xFF;
+        }
+
+        state.timerOrigin = static_cast<i64>(cpu.cycles);
+        state.sciReceived.clear();
+        state.sciShifting = false;
+        state.sciBuffered = false;
+        state.spiBusy = false;
+
+        for (u8 i = 0; i < outputCompares.size(); i++)
+            ScheduleCompare(i);
+
+        ScheduleOverflow();
+        scheduler.Schedule(realTimeEvent, cpu.cycles + RealTimePeriod());
+        scheduler.Cancel(sciTransmitEvent);
+        scheduler.Cancel(sciReceiveEvent);
+        scheduler.Cancel(spiEvent);
+        scheduler.Cancel(adcEvent);
+        UpdateInterrupts();
+    }
+
+    // NOTE: queues bytes arriving on RxD; they are received one frame time apart
+    void SciReceive(u8 byte) {
+        state.sciReceived.push_back(byte);
+
+        if (!scheduler.Pending(sciReceiveEvent))
+            scheduler.Schedule(sciReceiveEvent, cpu.cycles + SciFrameCycles());
+    }
+
+    // NOTE: both pins are active low levels on the part; here true means asserted
+    void SetIrq(bool asserted) {
+        state.irqPin = asserted;
+        UpdateInterrupts();
+    }
+
+    void SetXirq(bool asserted) {
+        cpu.xirqRequested = asserted;
+        UpdateInterrupts();
+    }
+
+    [[nodiscard]] u8 Register(u16 offset) const { return state.registers[offset]; }
+
+    [[nodiscard]] const State &Save() const { return state; }
+
+    // NOTE: the interrupt lines are worked out again from the restored flags, except XIRQ which belongs to the CPU
+    void Restore(const State &saved) {
+        state = saved;
+        UpdateInterrupts();
+    }
+
+    [[nodiscard]] u16 Tcnt() const { return static_cast<u16>(Ticks(cpu.cycles)); }
+
+    static constexpr u8 ScsrTdre = 0x80;
+    static constexpr u8 ScsrTc = 0x40;
+    static constexpr u8 ScsrRdrf = 0x20;
+    static constexpr u8 ScsrOr = 0x08;
+    static constexpr u8 SpsrSpif = 0x80;
+    static constexpr u8 SpsrWcol = 0x40;
+    static constexpr u8 AdctlCcf = 0x80;
+    static constexpr u8 Tflg2Tof = 0x80;
+    static constexpr u8 Tflg2Rtif = 0x40;
+    // NOTE: PSEL selecting IRQ, which is where it already is by default
+    static constexpr u8 HprioReset = 0x06;
+
+private:
+    // NOTE: the maskable sources in their default priority order, highest first
+    enum class Source : u8 {
+        Irq,
+        RealTime,
+        Tic1,
+        Tic2,
+        Tic3,
+        Toc1,
+        Toc2,
+        Toc3,
+        Toc4,
+        Ti4o5,
+        TimerOverflow,
+        PulseAccumulatorOverflow,
+        PulseAccumulatorInput,
+        Spi,
+        Sci
+    };
+
+    static constexpr u8 SourceCount = 15;
+
+    static constexpr std::array<u16, SourceCount> sourceVectors = {
+            Vectors::Irq, Vectors::RealTime, Vectors::Tic1, Vectors::Tic2, Vectors::Tic3, Vectors::Toc1, Vectors::Toc2,
+            Vectors::Toc3, Vectors::Toc4, Vectors::Toc5, Vectors::TimerOverflow, Vectors::PulseAccumulatorOverflow,
+            Vectors::PulseAccumulatorInput, Vectors::Spi, Vectors::Sci
+    };
+
+    // NOTE: what each value of PSEL in HPRIO promotes to the top; 0101 is reserved and leaves the order alone
+    static constexpr std::array<Source, 16> promotions = {
+            Source::TimerOverflow, Source::PulseAccumulatorOverflow, Source::PulseAccumulatorInput, Source::Spi,
+            Source::Sci, Source::Irq, Source::Irq, Source::RealTime, Source::Tic1, Source::Tic2, Source::Tic3,
+            Source::Toc1, Source::Toc2, Source::Toc3, Source::Toc4, Source::Ti4o5
+    };
+
+    [[nodiscard]] bool Requested(Source source) const {
+        const u8 timer = state.registers[Registers::TMSK1] & state.registers[Registers::TFLG1];
+        const u8 timer2 = state.registers[Registers::TMSK2] & state.registers[Registers::TFLG2];
+        const u8 status = state.registers[Registers::SCSR];
+        const u8 control = state.registers[Registers::SCCR2];
+
+        switch (source) {
+            case Source::Irq:
+                return state.irqPin;
+            case Source::RealTime:
+                return timer2 & 0x40;
+            case Source::Tic1:
+            case Source::Tic2:
+            case Source::Tic3:
+                return timer & (0x04 >> (static_cast<u8>(source) - static_cast<u8>(Source::Tic1)));
+            case Source::Toc1:
+            case Source::Toc2:
+            case Source::Toc3:
+            case Source::Toc4:
+            case Source::Ti4o5:
+                return timer & (0x80 >> (static_cast<u8>(source) - static_cast<u8>(Source::Toc1)));
+            case Source::TimerOverflow:
+                return timer2 & 0x80;
+            case Source::PulseAccumulatorOverflow:
+                return timer2 & 0x20;
+            case Source::PulseAccumulatorInput:
+                return timer2 & 0x10;
+            case Source::Spi:
+                return state.registers[Registers::SPCR] & state.registers[Registers::SPSR] & SpsrSpif;
+            case Source::Sci:
+                return (control & 0x80 && status & ScsrTdre) || (control & 0x40 && status & ScsrTc)
+                       || (control & 0x20 && status & (ScsrRdrf | ScsrOr));
+        }
+
+        return false;
+    }
+
+    // NOTE: called after anything that can change a flag or an enable; a request raised in the middle of a batch
+    // pulls in the CPU's deadline so it is taken at the next instruction
+    void UpdateInterrupts() {
+        const Source promoted = promotions[state.registers[Registers::HPRIO] & 0x0F];
+        u16 vector = 0;
+
+        if (Requested(promoted)) {
+            vector = sourceVectors[static_cast<u8>(promoted)];
+        } else {
+            for (u8 i = 0; i < SourceCount && vector == 0; i++) {
+                if (Requested(static_cast<Source>(i)))
+                    vector = sourceVectors[i];
+            }
+        }
+
+        cpu.irqVector = vector;
+
+        if (cpu.InterruptPending())
+            cpu.deadline = std::min(cpu.deadline, cpu.cycles);
+    }
+
+    // NOTE: timer ticks since state.timerOrigin, not wrapped to 16 bits
+    [[nodiscard]] i64 Ticks(u64 now) const {
+        return (static_cast<i64>(now) - state.timerOrigin) / Prescale();
+    }
+
+    [[nodiscard]] u64 TickTime(i64 ticks) const {
+        return static_cast<u64>(state.timerOrigin + ticks * Prescale());
+    }
+
+    [[nodiscard]] i64 Prescale() const {
+        static constexpr std::array<i64, 4> prescales = { 1, 4, 8, 16 };
+        return prescales[state.registers[Registers::TMSK2] & 0x03];
+    }
+
+    [[nodiscard]] u64 RealTimePeriod() const {
+        return u64(0x2000) << (state.registers[Registers::PACTL] & 0x03);
+    }
+
+    [[nodiscard]] u64 SciFrameCycles() const {
+        static constexpr std::array<u64, 4> prescales = { 1, 3, 4, 13 };
+        const u8 baud = state.registers[Registers::BAUD];
+
+        // NOTE: one start bit, eight data bits and a stop bit, each 16 receiver clocks long
+        return 10 * 16 * prescales[(baud >> 4) & 0x03] << (baud & 0x07);
+    }
+
+    [[nodiscard]] u64 SpiByteCycles() const {
+        static constexpr std::array<u64, 4> dividers = { 2, 4, 16, 32 };
+        return 8 * dividers[state.registers[Registers::SPCR] & 0x03];
+    }
+
+    // NOTE: the next tick after now at which the low 16 bits of the count equal value
+    [[nodiscard]] u64 NextMatch(u16 value) const {
+        const i64 now = Ticks(cpu.cycles);
+        i64 delta = static_cast<u16>(value - static_cast<u16>(now));
+
+        if (delta == 0)
+            delta = 0x10000;
+
+        return TickTime(now + delta);
+    }
+
+    void ScheduleCompare(u8 index) {
+        const u16 offset = Registers::TOC1 + 2 * index;
+        scheduler.Schedule(outputCompares[index], NextMatch(state.registers[offset] << 8 | state.registers[offset + 1]));
+    }
+
+    void ScheduleOverflow() {
+        scheduler.Schedule(overflowEvent, NextMatch(0));
+    }
+
+    void OutputCompare(u8 index, u64) {
+        state.registers[Registers::TFLG1] |= 0x80 >> index;
+        ScheduleCompare(index);
+        UpdateInterrupts();
+    }
+
+    void Overflow(u64) {
+        state.registers[Registers::TFLG2] |= Tflg2Tof;
+        ScheduleOverflow();
+        UpdateInterrupts();
+    }
+
+    void RealTimeInterrupt(u64 when) {
+        state.registers[Registers::TFLG2] |= Tflg2Rtif;
+        scheduler.Schedule(realTimeEvent, when + RealTimePeriod());
+        UpdateInterrupts();
+    }
+
+    void SciStartFrame() {
+        state.sciShifting = true;
+        state.registers[Registers::SCSR] &= ~ScsrTc;
+        scheduler.Schedule(sciTransmitEvent, cpu.cycles + SciFrameCycles());
+    }
+
+    void SciTransmitDone() {
+        if (sciTransmit)
+            sciTransmit(state.sciShiftData);
+
+        state.sciShifting = false;
+
+        if (state.sciBuffered) {
+            state.sciBuffered = false;
+            state.sciShiftData = state.sciBufferData;
+            state.registers[Registers::SCSR] |= ScsrTdre;
+            SciStartFrame();
+        } else {
+            state.registers[Registers::SCSR] |= ScsrTc;
+        }
+
+        UpdateInterrupts();
+    }
+
+    void SciReceiveDone() {
+        if (state.sciReceived.empty())
+            return;
+
+        // NOTE: with the receiver off, bytes on the line are lost
+        if (state.registers[Registers::SCCR2] & 0x04) {
+            if (state.registers[Registers::SCSR] & ScsrRdrf) {
+                state.registers[Registers::SCSR] |= ScsrOr;
+            } else {
+                state.sciReceiveData = state.sciReceived.front();
+                state.registers[Registers::SCSR] |= ScsrRdrf;
+            }
+        }
+
+        state.sciReceived.pop_front();
+
+        if (!state.sciReceived.empty())
+            scheduler.Schedule(sciReceiveEvent, cpu.cycles + SciFrameCycles());
+
+        UpdateInterrupts();
+    }
+
+    void SpiDone() {
+        state.spiBusy = false;
+        state.registers[Registers::SPDR] = spiExchange ? spiExchange(state.spiOut) : 0xFF;
+        state.registers[Registers::SPSR] |= SpsrSpif;
+        UpdateInterrupts();
+    }
+
+    // NOTE: four conversions of 32 cycles each, one result register per conversion
+    void AdcDone() {
+        const u8 control = state.registers[Registers::ADCTL];
+
+        for (u8 i = 0; i < 4; i++) {
+            const u8 channel = control & 0x10 ? (control & 0x0C) + i : control & 0x0F;
+            state.registers[Registers::ADR1 + i] = adcSample ? adcSample(channel) : 0;
+        }
+
+        state.registers[Registers::ADCTL] |= AdctlCcf;
+
+        if (control & 0x20)
+            scheduler.Schedule(adcEvent, cpu.cycles + 128);
+    }
+
+    u8 Read(u16 offset) {
+        switch (offset) {
+            case Registers::TCNT:
+                state.tcntLatch = Tcnt();
+                state.tcntLatched = true;
+                return state.tcntLatch >> 8;
+            case Registers::TCNT + 1:
+                // NOTE: reading the high byte first latches the low byte, so a 16-bit read sees one count
+                return (std::exchange(state.tcntLatched, false) ? state.tcntLatch : Tcnt()) & 0xFF;
+            case Registers::SCDR:
+                state.registers[Registers::SCSR] &= ~(ScsrRdrf | ScsrOr);
+                UpdateInterrupts();
+                return state.sciReceiveData;
+            case Registers::SPDR:
+                state.registers[Registers::SPSR] &= ~(SpsrSpif | SpsrWcol);
+                UpdateInterrupts();
+                return state.registers[offset];
+            default:
+                return state.registers[offset];
+        }
+    }
+
+    void Write(u16 offset, u8 value) {
+        Store(offset, value);
+        UpdateInterrupts();
+    }
+
+    void Store(u16 offset, u8 value) {
+        switch (offset) {
+            case Registers::TCNT:
+            case Registers::TCNT + 1:
+                return;
+            case Registers::TFLG1:
+            case Registers::TFLG2:
+                // NOTE: flags are cleared by writing ones
+                state.registers[offset] &= ~value;
+                return;
+            case Registers::TMSK2: {
+                // NOTE: keeps the count where it is across a prescaler change
+                const i64 ticks = Ticks(cpu.cycles);
+                state.registers[offset] = value;
+                state.timerOrigin = static_cast<i64>(cpu.cycles) - ticks * Prescale();
+
+                for (u8 i = 0; i < outputCompares.size(); i++)
+                    ScheduleCompare(i);
+
+                ScheduleOverflow();
+                return;
+            }
+            case Registers::PACTL:
+                state.registers[offset] = value;
+                scheduler.Schedule(realTimeEvent, cpu.cycles + RealTimePeriod());
+                return;
+            case Registers::SCSR:
+                return;
+            case Registers::SCDR:
+                if (!(state.registers[Registers::SCCR2] & 0x08))
+                    return;
+
+                if (!state.sciShifting) {
+                    state.sciShiftData = value;
+                    SciStartFrame();
+                } else {
+                    state.sciBufferData = value;
+                    state.sciBuffered = true;
+                    state.registers[Registers::SCSR] &= ~ScsrTdre;
+                }
+
+                return;
+            case Registers::SPDR:
+                // NOTE: only the master side is modeled, SPE and MSTR have to be set
+                if ((state.registers[Registers::SPCR] & 0x50) != 0x50)
+                    return;
+
+                if (state.spiBusy) {
+                    state.registers[Registers::SPSR] |= SpsrWcol;
+                    return;
+                }
+
+                state.spiBusy = true;
+                state.spiOut = value;
+                scheduler.Schedule(spiEvent, cpu.cycles + SpiByteCycles());
+                return;
+            case Registers::SPSR:
+                return;
+            case Registers::ADCTL:
+                state.registers[offset] = value & 0x3F;
+                scheduler.Schedule(adcEvent, cpu.cycles + 128);
+                return;
+            default:
+                state.registers[offset] = value;
+
+                if (offset >= Registers::TOC1 && offset <= Registers::TOC5 + 1)
+                    ScheduleCompare((offset - Registers::TOC1) / 2);
+
+                return;
+        }
+    }
+
+    Cpu &cpu;
+    Scheduler &scheduler;
+    State state;
+
+    std::array<EventId, 5> outputCompares {};
+    EventId overflowEvent;
+    EventId realTimeEvent;
+    EventId sciTransmitEvent;
+    EventId sciReceiveEvent;
+    EventId spiEvent;
+    EventId adcEvent;
+};
+
+#endif //M68HC11_PERIPHERALS_H
@@ -0,0 +1,259 @@
+#ifndef M68HC11_PROFILER_H
+#define M68HC11_PROFILER_H
+
+#include "assembler.h"
+#include "cpu.h"
+#include "m68hc11x.h"
+#include <algorithm>
+#include <array>
+#include <format>
+#include <iterator>
+#include <ostream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// NOTE: what an instruction does to the call stack; SWI and the illegal opcode trap enter a handler like a call
+enum class StackEffect : u8 {
+    None,
+    Call,
+    Return
+};
+
+consteval std::array<std::array<StackEffect, 256>, 4> BuildStackEffects() {
+    std::array<std::array<StackEffect, 256>, 4> effects {};
+
+    for (sz_t page = 0; page < effects.size(); page++) {
+        for (sz_t opcode = 0; opcode < 256; opcode++) {
+            const InstructionRef instruction = DecodeTables[page][opcode].instruction;
+            const std::string_view mnemonic = instruction ? instruction->mnemonic : std::string_view();
+
+            if (!instruction || mnemonic == "JSR" || mnemonic == "BSR" || mnemonic == "SWI")
+                effects[page][opcode] = StackEffect::Call;
+            else if (mnemonic == "RTS" || mnemonic == "RTI")
+                effects[page][opcode] = StackEffect::Return;
+        }
+    }
+
+    // NOTE: the prefixes themselves are not instructions
+    for (sz_t page = 1; page < PagePrefixes.size(); page++)
+        effects[0][PagePrefixes[page]] = StackEffect::None;
+
+    return effects;
+}
+
+inline constexpr std::array<std::array<StackEffect, 256>, 4> StackEffects = BuildStackEffects();
+
+// Counts the cycles spent at every address, and in every distinct call stack, as the CPU runs under the Profiled
+// policy. Nothing is sampled: each instruction is charged the cycles that passed until the next one started, so time
+// spent waiting on WAI lands on the WAI. Calls are followed from JSR, BSR, SWI and interrupt entry, returns from RTS
+// and RTI; an unbalanced return at the outermost frame is ignored, so code that adjusts the stack by hand only skews
+// the call graph, never the flat counts.
+//
+// The results map back to source through the assembler's rows: a frame is named after the label of the row its
+// function starts at, or the closest label before it.
+class Profiler {
+public:
+    static constexpr sz_t MaxDepth = 256;
+
+    Profiler() {
+        Reset();
+    }
+
+    void Record(const Cpu &cpu) {
+        Charge(cpu);
+        Settle(cpu.state.PC);
+
+        const u8 first = cpu.bus.Peek(cpu.state.PC);
+        sz_t page = 0;
+
+        for (sz_t i = 1; i < PagePrefixes.size(); i++) {
+            if (first == PagePrefixes[i])
+                page = i;
+        }
+
+        const u8 opcode = page == 0 ? first : cpu.bus.Peek(cpu.state.PC + 1);
+        pending = StackEffects[page][opcode];
+        lastPC = cpu.state.PC;
+    }
+
+    // NOTE: PC is still where the interrupted code continues, the handler becomes the next frame
+    void Interrupt(const Cpu &cpu) {
+        Charge(cpu);
+        Settle(cpu.state.PC);
+        pending = StackEffect::Call;
+    }
+
+    void Reset() {
+        std::fill(cycles.begin(), cycles.end(), 0);
+        nodes.assign(1, { 0, 0, 0 });
+        children.clear();
+        stack.clear();
+        hiddenFrames = 0;
+        pending = StackEffect::None;
+        started = false;
+    }
+
+    // NOTE: indexed by the address each instruction starts at
+    [[nodiscard]] std::span<const u64> Cycles() const { return cycles; }
+
+    // NOTE: the cycles spent in the bytes of every row, in row order
+    [[nodiscard]] std::vector<u64> RowCycles(const RowTable &rows) const {
+        std::vector<u64> result(rows.size());
+
+        for (sz_t i = 0; i < rows.size(); i++) {
+            for (u16 address = rows.address[i]; address != rows.End(i); address++)
+                result[i] += cycles[address];
+        }
+
+        return result;
+    }
+
+    // NOTE: the listing with each row's cycles and share of the total in front, rows that never ran left blank
+    void WriteListing(std::ostream &out, const RowTable &rows) const {
+        const std::vector<u64> perRow = RowCycles(rows);
+        u64 total = 0;
+
+        for (const u64 count : cycles)
+            total += count;
+
+        for (sz_t i = 0; i < rows.size(); i++) {
+            if (perRow[i] > 0)
+                out << std::format("{:>12} {:6.2f}% ", perRow[i], 100.0 * perRow[i] / total);
+            else
+                out << std::string(21, ' ');
+
+            out << std::format("{:>5}  ", rows.line[i]) << rows[i].str() << '\n';
+        }
+    }
+
+    // NOTE: one line per call stack that spent any cycles, "outer;inner cycles", which flamegraph.pl and speedscope
+    // read directly
+    void WriteCollapsed(std::ostream &out, const RowTable &rows) const {
+        std::vector<std::string> paths(nodes.size());
+        const std::vector<Label> labels = SortedLabels(rows);
+
+        for (sz_t i = 0; i < nodes.size(); i++) {
+            const std::string name = FrameName(rows, labels, nodes[i].function);
+            paths[i] = i == 0 ? name : paths[nodes[i].parent] + ";" + name;
+
+            if (nodes[i].cycles > 0)
+                out << paths[i] << ' ' << nodes[i].cycles << '\n';
+        }
+    }
+
+private:
+    struct Node {
+        u16 function;
+        u32 parent;
+        u64 cycles;
+    };
+
+    struct Label {
+        u16 address;
+        sz_t row;
+    };
+
+    void Charge(const Cpu &cpu) {
+        if (!started) {
+            nodes[0].function = cpu.state.PC;
+            lastCycles = cpu.cycles;
+            started = true;
+            return;
+        }
+
+        const u64 elapsed = cpu.cycles - lastCycles;
+        cycles[lastPC] += elapsed;
+        nodes[Current()].cycles += elapsed;
+        lastCycles = cpu.cycles;
+    }
+
+    // NOTE: applies the last instruction's effect now that it is known where it went
+    void Settle(u16 pc) {
+        if (pending == StackEffect::Call)
+            Push(pc);
+        else if (pending == StackEffect::Return)
+            Pop();
+
+        pending = StackEffect::None;
+    }
+
+    [[nodiscard]] u32 Current() const { return stack.empty() ? 0 : stack.back(); }
+
+    void Push(u16 function) {
+        if (stack.size() >= MaxDepth) {
+            hiddenFrames++;
+            return;
+        }
+
+        const u32 parent = Current();
+        const u64 key = u64(parent) << 16 | function;
+        auto [it, inserted] = children.try_emplace(key, static_cast<u32>(nodes.size()));
+
+        if (inserted)
+            nodes.push_back({ function, parent, 0 });
+
+        stack.push_back(it->second);
+    }
+
+    void Pop() {
+        if (hiddenFrames > 0)
+            hiddenFrames--;
+        else if (!stack.empty())
+            stack.pop_back();
+    }
+
+    // NOTE: the labelled rows by address, the later row last where two share one, built once per output so every
+    // frame is named with a binary search
+    [[nodiscard]] static std::vector<Label> SortedLabels(const RowTable &rows) {
+        std::vector<Label> labels;
+
+        for (sz_t i = 0; i < rows.size(); i++) {
+            if (!rows[i].label.empty())
+                labels.push_back({ rows.address[i], i });
+        }
+
+        std::sort(labels.begin(), labels.end(), [](const Label &a, const Label &b) {
+            return a.address != b.address ? a.address < b.address : a.row < b.row;
+        });
+
+        return labels;
+    }
+
+    [[nodiscard]] static std::string FrameName(const RowTable &rows, std::span<const Label> labels, u16 function) {
+        const auto after = std::upper_bound(labels.begin(), labels.end(), function,
+                                            [](u16 address, const Label &label) { return address < label.address; });
+
+        if (after == labels.begin())
+            return std::format("${:04X}", function);
+
+        const Row row = rows[std::prev(after)->row];
+        return row.address == function ? std::string(row.label)
+                                       : std::format("{}+{}", row.label, function - row.address);
+    }
+
+    std::vector<u64> cycles = std::vector<u64>(0x10000);
+
+    // NOTE: the call tree, node 0 being where profiling started; children maps parent and function to a node
+    std::vector<Node> nodes;
+    std::unordered_map<u64, u32> children;
+    std::vector<u32> stack;
+    sz_t hiddenFrames = 0;
+
+    StackEffect pending = StackEffect::None;
+    u16 lastPC = 0;
+    u64 lastCycles = 0;
+    bool started = false;
+};
+
+// NOTE: the trace policy that counts into Cpu::profiler, which has to be set
+struct Profiled {
+    static constexpr bool Enabled = true;
+
+    static void Record(const Cpu &cpu) { cpu.profiler->Record(cpu); }
+    static void Interrupt(const Cpu &cpu) { cpu.profiler->Interrupt(cpu); }
+};
+
+#endif //M68HC11_PROFILER_H
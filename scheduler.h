@@ -0,0 +1,127 @@
+#ifndef M68HC11_SCHEDULER_H
+#define M68HC11_SCHEDULER_H
+
+#include "cpu.h"
+#include "m68hc11x.h"
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+using EventId = u32;
+using EventFn = std::function<void(u64 when)>;
+
+// Time ordered queue of peripheral events, keyed on the CPU's cycle counter. Each event is registered once and can
+// be pending at most once: scheduling it again moves it, so a peripheral never has to find and remove its old entry.
+// Stale heap entries are recognized by their sequence number and dropped when they reach the top.
+class Scheduler {
+public:
+    static constexpr u64 Never = ~u64(0);
+
+    struct Slot {
+        u32 sequence;
+        u64 when;
+    };
+
+    struct Entry {
+        u64 when;
+        u64 order;
+        EventId id;
+        u32 sequence;
+    };
+
+    // NOTE: everything but the callbacks, which stay with the scheduler they were registered on
+    struct State {
+        std::vector<Slot> slots;
+        std::vector<Entry> heap;
+        u64 order = 0;
+    };
+
+    explicit Scheduler(Cpu &cpu) : cpu(cpu) {}
+
+    Scheduler(const Scheduler &) = delete;
+    Scheduler &operator=(const Scheduler &) = delete;
+
+    EventId Register(EventFn callback) {
+        callbacks.push_back(std::move(callback));
+        state.slots.push_back({ 0, Never });
+        return static_cast<EventId>(callbacks.size() - 1);
+    }
+
+    // NOTE: a time in the past runs the event as soon as the current batch ends
+    void Schedule(EventId id, u64 when) {
+        Slot &slot = state.slots[id];
+        slot.sequence++;
+        slot.when = when;
+
+        state.heap.push_back({ when, state.order++, id, slot.sequence });
+        std::push_heap(state.heap.begin(), state.heap.end(), Later);
+
+        // NOTE: the CPU may be in the middle of a batch that was meant to run past this event
+        cpu.deadline = std::min(cpu.deadline, when);
+    }
+
+    void Cancel(EventId id) {
+        state.slots[id].sequence++;
+        state.slots[id].when = Never;
+    }
+
+    [[nodiscard]] bool Pending(EventId id) const { return state.slots[id].when != Never; }
+    [[nodiscard]] u64 When(EventId id) const { return state.slots[id].when; }
+
+    [[nodiscard]] u64 NextTime() {
+        DropStale();
+        return state.heap.empty() ? Never : state.heap.front().when;
+    }
+
+    // NOTE: events run in time order, ties in the order they were scheduled; an event may schedule more work, which
+    // runs in the same call if it is due by now as well
+    void RunDue(u64 now) {
+        while (NextTime() <= now) {
+            std::pop_heap(state.heap.begin(), state.heap.end(), Later);
+            const Entry entry = state.heap.back();
+            state.heap.pop_back();
+
+            state.slots[entry.id].when = Never;
+            callbacks[entry.id](entry.when);
+        }
+    }
+
+    // NOTE: keeps the registered events but forgets every pending occurrence
+    void Clear() {
+        for (Slot &slot : state.slots) {
+            slot.sequence++;
+            slot.when = Never;
+        }
+
+        state.heap.clear();
+    }
+
+    [[nodiscard]] const State &Save() const { return state; }
+
+    // NOTE: the state has to come from a scheduler with the same events registered in the same order
+    void Restore(const State &saved) {
+        if (saved.slots.size() != callbacks.size())
+            throw std::runtime_error("Snapshot was taken with different events registered");
+
+        state = saved;
+    }
+
+private:
+    static bool Later(const Entry &a, const Entry &b) {
+        return a.when != b.when ? a.when > b.when : a.order > b.order;
+    }
+
+    void DropStale() {
+        while (!state.heap.empty() && state.heap.front().sequence != state.slots[state.heap.front().id].sequence) {
+            std::pop_heap(state.heap.begin(), state.heap.end(), Later);
+            state.heap.pop_back();
+        }
+    }
+
+    Cpu &cpu;
+    std::vector<EventFn> callbacks;
+    State state;
+};
+
+#endif //M68HC11_SCHEDULER_H
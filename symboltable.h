@@ -0,0 +1,104 @@
+#ifndef M68HC11_SYMBOLTABLE_H
+#define M68HC11_SYMBOLTABLE_H
+
+#include "m68hc11x.h"
+#include <cstring>
+#include <memory_resource>
+#include <string_view>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+using SymbolId = u32;
+inline constexpr SymbolId NoSymbol = ~SymbolId(0);
+inline constexpr u32 NoFixup = ~u32(0);
+
+enum class FixupKind : u8 {
+    Relative8,
+    Absolute8,
+    Absolute16
+};
+
+// NOTE: one use of a symbol as an operand, patched into the last bytes of its row once the symbol has a value. Uses of
+// the same symbol are chained through next, newest first. A relaxable use may still switch to a longer encoding.
+struct Fixup {
+    u32 row;
+    SymbolId symbol;
+    FixupKind kind;
+    bool relaxable;
+    u32 next;
+};
+
+struct Symbol {
+    std::string_view name;
+    u16 value;
+    bool defined;
+    u32 fixups;
+};
+
+// Interns label names into dense integer IDs. Names are copied into the backing memory resource, so they stay valid
+// independently of the source text they were first seen in.
+class SymbolTable {
+public:
+    explicit SymbolTable(std::pmr::memory_resource *memory) : memory(memory), ids(memory), symbols(memory) {}
+
+    SymbolId Intern(std::string_view name) {
+        if (const auto it = ids.find(name); it != ids.end())
+            return it->second;
+
+        char *copy = static_cast<char *>(memory->allocate(name.size(), alignof(char)));
+        std::memcpy(copy, name.data(), name.size());
+
+        const std::string_view stored(copy, name.size());
+        const SymbolId id = static_cast<SymbolId>(symbols.size());
+
+        symbols.push_back({ stored, 0, false, NoFixup });
+        ids.emplace(stored, id);
+
+        return id;
+    }
+
+    [[nodiscard]] SymbolId Find(std::string_view name) const {
+        const auto it = ids.find(name);
+        return it != ids.end() ? it->second : NoSymbol;
+    }
+
+    void Define(SymbolId id, u16 value) {
+        symbols[id].value = value;
+        symbols[id].defined = true;
+    }
+
+    void Undefine(SymbolId id) {
+        symbols[id].defined = false;
+    }
+
+    // NOTE: makes fixup the head of the symbol's chain and returns the previous head, to be stored as its next
+    u32 ChainFixup(SymbolId id, u32 fixup) {
+        return std::exchange(symbols[id].fixups, fixup);
+    }
+
+    void UnchainFixups() {
+        for (Symbol &symbol : symbols)
+            symbol.fixups = NoFixup;
+    }
+
+    [[nodiscard]] const Symbol &operator[](SymbolId id) const { return symbols[id]; }
+    [[nodiscard]] sz_t size() const { return symbols.size(); }
+
+    [[nodiscard]] std::string_view Name(SymbolId id) const {
+        return id == NoSymbol ? std::string_view() : symbols[id].name;
+    }
+
+    // NOTE: must run before the backing arena is rewound so nothing keeps pointing into reclaimed memory
+    void Clear() {
+        ids = decltype(ids)(memory);
+        symbols = decltype(symbols)(memory);
+    }
+
+private:
+    std::pmr::memory_resource *memory;
+    std::pmr::unordered_map<std::string_view, SymbolId> ids;
+    std::pmr::vector<Symbol> symbols;
+};
+
+#endif //M68HC11_SYMBOLTABLE_H
@@ -0,0 +1,640 @@
+#include "assembler.h"
+#include "batchemulator.h"
+#include "blockcache.h"
+#include "bus.h"
+#include "cpu.h"
+#include "debugger.h"
+#include "image.h"
+#include "jit.h"
+#include "m68hc11x.h"
+#include "machine.h"
+#include "peripherals.h"
+#include "profiler.h"
+#include "scheduler.h"
+#include "trace.h"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <filesystem>
+#include <format>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Behaviour checks for the emulator, built once with M68HC11_JIT and once without. Every program is assembled from
+// source, starts at START and has its vectors loaded by hand; a failed check is reported and the run exits non-zero.
+
+static i32 failures = 0;
+
+static void Check(bool condition, std::string_view what) {
+    if (!condition) {
+        std::printf("FAILED: %.*s\n", static_cast<i32>(what.size()), what.data());
+        failures++;
+    }
+}
+
+static u16 Symbol(const Assembler &assembler, std::string_view name) {
+    return static_cast<u16>(assembler.symbols[assembler.symbols.Find(name)].value);
+}
+
+static void SetVector(Bus &bus, u16 vector, u16 address) {
+    const std::array<u8, 2> bytes = { static_cast<u8>(address >> 8), static_cast<u8>(address) };
+    bus.Load(vector, bytes);
+}
+
+static void LoadProgram(Machine &machine, Assembler &assembler, const std::string &source) {
+    assembler.Assemble(source);
+
+    for (const ImageSegment &segment : Image::FromRows(assembler.lines).segments)
+        machine.bus.Load(segment.address, segment.bytes);
+
+    SetVector(machine.bus, Vectors::Reset, Symbol(assembler, "START"));
+}
+
+static void TestInstructionResults() {
+    Machine machine;
+    Assembler assembler;
+    LoadProgram(machine, assembler,
+                " ORG $C000\n"
+                "START LDS #$FF\n"
+                " LDAA #$7F\n"
+                " ADDA #1\n"
+                " TPA\n"
+                " STAA FLAGS\n"
+                " LDX #$1234\n"
+                " LDAB #$80\n"
+                " ABX\n"
+                " STX SUM\n"
+                " JSR TWICE\n"
+                " LDAA #12\n"
+                " LDAB #10\n"
+                " MUL\n"
+                " STD PRODUCT\n"
+                "DONE BRA DONE\n"
+                "TWICE INC COUNT\n"
+                " INC COUNT\n"
+                " RTS\n"
+                " ORG $0080\n"
+                "FLAGS RMB 1\n"
+                "SUM RMB 2\n"
+                "PRODUCT RMB 2\n"
+                "COUNT RMB 1\n");
+    machine.Reset();
+    machine.Run(1000);
+
+    const Bus &bus = machine.bus;
+    const u8 flags = bus.Peek(Symbol(assembler, "FLAGS"));
+    Check((flags & 0x2F) == (CcrFlags::H | CcrFlags::N | CcrFlags::V), "$7F + 1 sets H, N and V only");
+    Check(bus.Peek(Symbol(assembler, "SUM")) == 0x12 && bus.Peek(Symbol(assembler, "SUM") + 1) == 0xB4,
+          "ABX adds B to X unsigned");
+    Check(bus.Peek(Symbol(assembler, "PRODUCT")) == 0 && bus.Peek(Symbol(assembler, "PRODUCT") + 1) == 120,
+          "MUL leaves A times B in D");
+    Check(bus.Peek(Symbol(assembler, "COUNT")) == 2 && machine.cpu.state.SP == 0xFF, "JSR and RTS balance the stack");
+    Check(machine.cpu.state.PC == Symbol(assembler, "DONE"), "the program ends in its last loop");
+}
+
+static void TestCodeInRamIsCached() {
+    Machine machine;
+    Assembler assembler;
+    LoadProgram(machine, assembler, " ORG $0010\nSTART INCA\n BRA START\n");
+    machine.Reset();
+    machine.Run(10000);
+
+    Check(machine.bus.IsPlainMemory(Symbol(assembler, "START")), "on-chip RAM below the registers is plain memory");
+    Check(machine.blocks.BlockCount() > 0, "code running from on-chip RAM is cached");
+}
+
+// NOTE: the loop body is random but keeps every access in on-chip RAM, so only the CPU and the real-time interrupt
+// decide what happens; forward branches end blocks part way through
+static std::string RandomLoop(std::mt19937 &random) {
+    static constexpr std::array<std::string_view, 32> Plain = {
+        "INCA", "DECB", "ABA", "SBA", "CBA", "TAB", "TBA", "COMA", "NEGB", "CLRA", "LSRA", "ASLB", "ROLA", "RORB",
+        "ASRA", "DAA", "MUL", "IDIV", "FDIV", "INX", "DEY", "INY", "DEX", "TPA", "CLC", "SEC", "CLV", "SEV", "LSRD",
+        "ASLD", "NOP", "COMB"
+    };
+    static constexpr std::array<std::string_view, 14> Immediate = {
+        "ADDA", "ADCB", "SUBA", "SBCB", "ANDA", "ORAB", "EORA", "BITB", "CMPA", "LDAA", "ADCA", "SUBB", "CMPB", "LDAB"
+    };
+    static constexpr std::array<std::string_view, 12> Memory = {
+        "STAA", "STAB", "STD", "LDAA", "ADDB", "INC", "ROR", "TST", "LDD", "ADDD", "SUBD", "NEG"
+    };
+    static constexpr std::array<std::string_view, 6> Branch = { "BEQ", "BNE", "BCS", "BCC", "BMI", "BVS" };
+
+    auto pick = [&random](sz_t count) { return std::uniform_int_distribution<sz_t>(0, count - 1)(random); };
+    std::string source = " ORG $C000\nSTART LDS #$FF\n LDAA #$40\n STAA $1024\n CLI\nLOOP LDX #$40\n LDY #$60\n";
+    const sz_t length = 8 + pick(24);
+
+    for (sz_t i = 0; i < length; i++) {
+        source.append(std::format("L{} ", i));
+
+        switch (pick(5)) {
+            case 0:
+                source.append(Plain[pick(Plain.size())]);
+                break;
+            case 1:
+                source.append(std::format("{} #${:02X}", Immediate[pick(Immediate.size())], pick(256)));
+                break;
+            case 2:
+                source.append(std::format("{} ${:02X}", Memory[pick(Memory.size())], 0x40 + pick(0x40)));
+                break;
+            case 3:
+                // NOTE: X and Y only drift by a few bytes from the loop head, so the offset stays clear of the stack
+                source.append(std::format("{} ${:02X},{}", Memory[pick(Memory.size())], pick(0x40),
+                                          pick(2) ? 'X' : 'Y'));
+                break;
+            default:
+                source.append(std::format("{} L{}", Branch[pick(Branch.size())], i + 1 + pick(length - i)));
+                break;
+        }
+
+        source.append("\n");
+    }
+
+    source.append(std::format("L{} BRA LOOP\nRTIH LDAA #$40\n STAA $1025\n RTI\n", length));
+    return source;
+}
+
+static void TestTranslatedMatchesInterpreted() {
+    std::mt19937 random(11);
+    bool same = true;
+
+    for (i32 i = 0; i < 50; i++) {
+        const std::string source = RandomLoop(random);
+        Machine translated, interpreted;
+
+        for (Machine *machine : { &translated, &interpreted }) {
+            Assembler assembler;
+            LoadProgram(*machine, assembler, source);
+            SetVector(machine->bus, Vectors::RealTime, Symbol(assembler, "RTIH"));
+            machine->Reset();
+        }
+
+        interpreted.blocks.SetJitEnabled(false);
+        const u64 executed = translated.Run(100000);
+        same = same && executed == interpreted.Run(100000);
+
+        const CPUState &a = translated.cpu.state, &b = interpreted.cpu.state;
+        same = same && translated.cpu.cycles == interpreted.cpu.cycles && a.PC == b.PC && a.SP == b.SP
+               && a.IX == b.IX && a.IY == b.IY && a.D == b.D && a.CCR() == b.CCR();
+
+        for (u16 address = 0; address < 0x100; address++)
+            same = same && translated.bus.Peek(address) == interpreted.bus.Peek(address);
+    }
+
+    Check(same, "translated blocks run the same way as interpreted ones");
+}
+
+// NOTE: receives each byte on the SCI by polling RDRF and sends it back one higher once TDRE says the buffer is free
+static void TestSciEcho() {
+    Machine machine;
+    Assembler assembler;
+    LoadProgram(machine, assembler,
+                " ORG $C000\n"
+                "START LDS #$FF\n"
+                " LDAA #$0C\n"
+                " STAA $102D\n"
+                "LOOP LDAA $102E\n"
+                " ANDA #$20\n"
+                " BEQ LOOP\n"
+                " LDAB $102F\n"
+                " INCB\n"
+                "FREE LDAA $102E\n"
+                " ANDA #$80\n"
+                " BEQ FREE\n"
+                " STAB $102F\n"
+                " BRA LOOP\n");
+    machine.Reset();
+
+    std::vector<u8> sent;
+    std::vector<u64> times;
+    machine.peripherals.sciTransmit = [&](u8 byte) {
+        sent.push_back(byte);
+        times.push_back(machine.cpu.cycles);
+    };
+
+    const u64 start = machine.cpu.cycles;
+
+    for (const u8 byte : { 1, 2, 3 })
+        machine.peripherals.SciReceive(byte);
+
+    machine.Run(100000);
+
+    Check(sent == std::vector<u8> { 2, 3, 4 }, "the SCI receives and transmits every byte");
+    // NOTE: at the reset BAUD a frame is 160 E clocks; each byte takes one to arrive and one to go out again, and the
+    // polling loops add a few cycles
+    bool onTime = times.size() == 3;
+
+    for (sz_t i = 0; i < times.size(); i++) {
+        const u64 frames = start + 160 * (i + 2);
+        onTime = onTime && times[i] >= frames && times[i] < frames + 48;
+    }
+
+    Check(onTime, "bytes are received and sent at the baud rate");
+    Check(machine.peripherals.Tcnt() == static_cast<u16>(machine.cpu.cycles - start),
+          "TCNT counts E clocks from reset at the default prescaler");
+}
+
+// NOTE: the real-time interrupt fires every 8192 cycles with RTR at its reset value
+static const std::string RealTimeProgram =
+        " ORG $C000\n"
+        "START LDS #$FF\n"
+        " LDAA #$40\n"
+        " STAA $1024\n"
+        " CLI\n"
+        "LOOP WAI\n"
+        " BRA LOOP\n"
+        "RTIH INC COUNT\n"
+        " LDAA #$40\n"
+        " STAA $1025\n"
+        " RTI\n"
+        " ORG $0080\n"
+        "COUNT RMB 1\n";
+
+static void TestInterruptEntryAndReturn() {
+    Machine machine;
+    Assembler assembler;
+    LoadProgram(machine, assembler, RealTimeProgram);
+    SetVector(machine.bus, Vectors::RealTime, Symbol(assembler, "RTIH"));
+    machine.Reset();
+
+    Debugger debugger(machine);
+    debugger.SetBreakpoint(Symbol(assembler, "RTIH"));
+    debugger.Run(100000);
+
+    const Cpu &cpu = machine.cpu;
+    Check(debugger.Halted() && cpu.state.PC == Symbol(assembler, "RTIH"), "interrupt enters the real-time handler");
+    Check(cpu.state.SP == 0xFF - 9, "interrupt entry stacks nine bytes");
+    Check(cpu.state.ccr & CcrFlags::I, "interrupt entry masks IRQ");
+
+    const u16 stackedPC = machine.bus.Peek(cpu.state.SP + 8) << 8 | machine.bus.Peek(cpu.state.SP + 9);
+    Check(stackedPC == Symbol(assembler, "LOOP") + 1, "the stacked PC is the instruction after WAI");
+
+    debugger.ClearBreakpoints();
+    debugger.SetBreakpoint(Symbol(assembler, "LOOP") + 1);
+    debugger.Run(100000);
+
+    Check(debugger.Halted() && cpu.state.PC == Symbol(assembler, "LOOP") + 1, "RTI returns after WAI");
+    Check(cpu.state.SP == 0xFF && !(cpu.state.ccr & CcrFlags::I), "RTI unstacks the registers");
+    Check(machine.bus.Peek(Symbol(assembler, "COUNT")) == 1, "the handler ran once");
+}
+
+static void TestWaitSkipsIdleTime() {
+    Machine machine;
+    Assembler assembler;
+    LoadProgram(machine, assembler, RealTimeProgram);
+    SetVector(machine.bus, Vectors::RealTime, Symbol(assembler, "RTIH"));
+    machine.Reset();
+
+    const u64 start = machine.cpu.cycles;
+    const u64 executed = machine.Run(1000000);
+    const u8 count = machine.bus.Peek(Symbol(assembler, "COUNT"));
+
+    Check(machine.cpu.cycles - start >= 1000000, "time passes while waiting");
+    Check(count >= 121 && count <= 123, "the handler runs once per real-time period");
+    Check(executed < 8 * 123, "waiting does not execute instructions");
+}
+
+static void TestSnapshotRoundTrip() {
+    Machine machine;
+    Assembler assembler;
+    LoadProgram(machine, assembler, RealTimeProgram);
+    SetVector(machine.bus, Vectors::RealTime, Symbol(assembler, "RTIH"));
+    machine.Reset();
+    machine.Run(30000);
+
+    const Snapshot snapshot = machine.Save();
+    const u8 count = machine.bus.Peek(Symbol(assembler, "COUNT"));
+
+    machine.Run(50000);
+    const CPUState first = machine.cpu.state;
+    const u64 firstCycles = machine.cpu.cycles;
+    const u8 firstCount = machine.bus.Peek(Symbol(assembler, "COUNT"));
+
+    machine.Restore(snapshot);
+    Check(machine.cpu.cycles == snapshot.cycles, "restore rewinds the cycle counter");
+    Check(machine.bus.Peek(Symbol(assembler, "COUNT")) == count, "restore rewinds memory");
+
+    machine.Run(50000);
+    Check(machine.cpu.cycles == firstCycles && machine.cpu.state.PC == first.PC && machine.cpu.state.SP == first.SP
+          && machine.cpu.state.CCR() == first.CCR(), "a restored machine runs the same way again");
+    Check(machine.bus.Peek(Symbol(assembler, "COUNT")) == firstCount, "a restored machine writes the same memory");
+}
+
+// NOTE: the byte received sets how long the program counts X down with the real-time interrupt disabled. It comes due
+// during the count and is taken as soon as the write to TMSK2 enables it again, in the middle of a block, and its
+// handler leaves the low byte of TCNT in LAST for the program to send. What is sent therefore depends on exactly when
+// every interrupt is taken.
+static const std::string CountdownProgram =
+        " ORG $C000\n"
+        "START LDS #$FF\n"
+        " LDAA #$0C\n"
+        " STAA $102D\n"
+        " LDAA #$40\n"
+        " STAA $1024\n"
+        " CLI\n"
+        "RECEIVE LDAA $102E\n"
+        " ANDA #$20\n"
+        " BEQ RECEIVE\n"
+        " LDAB $102F\n"
+        " STAB COUNT\n"
+        "LOOP LDAB COUNT\n"
+        " CLRA\n"
+        " LSLD\n"
+        " LSLD\n"
+        " LSLD\n"
+        " LSLD\n"
+        " XGDX\n"
+        " CLR $1024\n"
+        "SPIN DEX\n"
+        " BNE SPIN\n"
+        " LDAA #$40\n"
+        " STAA $1024\n"
+        " LDAA LAST\n"
+        "FREE LDAB $102E\n"
+        " ANDB #$80\n"
+        " BEQ FREE\n"
+        " STAA $102F\n"
+        " BRA LOOP\n"
+        "RTIH LDAA $100F\n"
+        " STAA LAST\n"
+        " LDAA #$40\n"
+        " STAA $1025\n"
+        " RTI\n"
+        " ORG $0080\n"
+        "COUNT RMB 1\n"
+        "LAST RMB 1\n";
+
+static void TestBatchDoesNotDependOnThreads() {
+    Machine machine;
+    Assembler assembler;
+    LoadProgram(machine, assembler, CountdownProgram);
+    SetVector(machine.bus, Vectors::RealTime, Symbol(assembler, "RTIH"));
+    machine.Reset();
+    const Snapshot boot = machine.Save();
+
+    std::mt19937 random(20);
+    std::vector<EmulationJob> jobs(24);
+
+    for (sz_t i = 0; i < jobs.size(); i++) {
+        jobs[i].name = std::format("job {}", i);
+
+        jobs[i].input.push_back(static_cast<u8>(std::uniform_int_distribution<i32>(100, 255)(random)));
+    }
+
+    WorkStealingPool one(1), four(4);
+    const EmulationReport serial = EmulateBatch(boot, jobs, 400000, one);
+    const EmulationReport parallel = EmulateBatch(boot, jobs, 400000, four);
+    bool same = serial.results.size() == jobs.size() && parallel.results.size() == jobs.size();
+
+    for (sz_t i = 0; same && i < jobs.size(); i++) {
+        const EmulationResult &a = serial.results[i], &b = parallel.results[i];
+        same = a.ok() && b.ok() && a.output.size() > 4 && a.output == b.output && a.cycles == b.cycles
+               && a.instructions == b.instructions && a.runState == b.runState;
+    }
+
+    Check(same, "a batch gives the same results on one worker as on four");
+
+    std::vector<u64> finished(jobs.size());
+    EmulationHooks hooks;
+    hooks.complete = [&](Machine &done, const EmulationJob &job) {
+        finished[&job - jobs.data()] = done.cpu.cycles - boot.cycles;
+    };
+
+    const EmulationReport hooked = EmulateBatch(boot, jobs, 400000, four, hooks);
+    bool seen = true;
+
+    for (sz_t i = 0; i < jobs.size(); i++)
+        seen = seen && finished[i] == hooked.results[i].cycles && hooked.results[i].output == serial.results[i].output;
+
+    Check(seen, "the complete hook sees every job's final state");
+}
+
+// NOTE: a trace policy that keeps every state as it is, for checking the encoded trace against
+struct Collected {
+    static constexpr bool Enabled = true;
+    static inline std::vector<TraceEntry> entries;
+
+    static void Record(const Cpu &cpu) {
+        const CPUState &state = cpu.state;
+        const u8 first = cpu.bus.Peek(state.PC);
+        const bool prefixed = first == 0x18 || first == 0x1A || first == 0xCD;
+        entries.push_back({ state.PC, prefixed ? first : u8(0), prefixed ? cpu.bus.Peek(state.PC + 1) : first, state.A,
+                            state.B, state.IX, state.IY, state.SP, state.CCR() });
+    }
+
+    static void Interrupt(const Cpu &) {}
+};
+
+static bool SameEntry(const TraceEntry &a, const TraceEntry &b) {
+    return a.pc == b.pc && a.prefix == b.prefix && a.opcode == b.opcode && a.A == b.A && a.B == b.B && a.IX == b.IX
+           && a.IY == b.IY && a.SP == b.SP && a.ccr == b.ccr;
+}
+
+static void TestTraceRingAndFile() {
+    std::mt19937 random(21);
+    const std::string source = RandomLoop(random);
+    Machine reference, traced;
+
+    for (Machine *machine : { &reference, &traced }) {
+        Assembler assembler;
+        LoadProgram(*machine, assembler, source);
+        SetVector(machine->bus, Vectors::RealTime, Symbol(assembler, "RTIH"));
+        machine->Reset();
+    }
+
+    Collected::entries.clear();
+    reference.Run<Collected>(300000);
+    const std::vector<TraceEntry> &expected = Collected::entries;
+
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "m68hc11-tests.trace";
+    TraceBuffer ring(2);
+    traced.cpu.trace = &ring;
+    ring.StartStreaming(path.string());
+    traced.Run<Traced>(300000);
+    ring.StopStreaming();
+
+    std::vector<TraceEntry> kept, streamed;
+    ring.ForEach([&](const TraceEntry &entry) { kept.push_back(entry); });
+    TraceBuffer::ReadFile(path.string(), [&](const TraceEntry &entry) { streamed.push_back(entry); });
+    std::filesystem::remove(path);
+
+    Check(ring.Recorded() == expected.size() && kept.size() < expected.size(),
+          "the ring counts every instruction but only keeps the newest");
+    Check(std::ranges::equal(kept, std::span(expected).last(kept.size()), SameEntry),
+          "the ring decodes to the last instructions executed");
+    Check(std::ranges::equal(streamed, expected, SameEntry), "the trace file decodes to every instruction executed");
+}
+
+// NOTE: every pass of LOOP spends 9 cycles in START, 17 in F, 9 in G and 7 in the call that enters G one byte in
+static void TestProfilerOutput() {
+    Machine machine;
+    Assembler assembler;
+    LoadProgram(machine, assembler,
+                " ORG $C000\n"
+                "START LDS #$FF\n"
+                "LOOP JSR F\n"
+                " BRA LOOP\n"
+                "F JSR G\n"
+                " JSR $C101\n"
+                " RTS\n"
+                " ORG $C100\n"
+                "G NOP\n"
+                " NOP\n"
+                " RTS\n");
+    machine.Reset();
+
+    Profiler profiler;
+    machine.cpu.profiler = &profiler;
+    machine.Run<Profiled>(100000);
+
+    std::ostringstream collapsed;
+    profiler.WriteCollapsed(collapsed, assembler.lines);
+    std::istringstream lines(collapsed.str());
+    std::vector<std::pair<std::string, u64>> stacks;
+
+    for (std::string stack; lines >> stack;) {
+        u64 cycles = 0;
+        lines >> cycles;
+        stacks.emplace_back(stack, cycles);
+    }
+
+    Check(stacks.size() == 4 && stacks[0].first == "START" && stacks[1].first == "START;F"
+          && stacks[2].first == "START;F;G" && stacks[3].first == "START;F;G+1",
+          "call stacks are named after the closest label before each function");
+
+    if (stacks.size() != 4)
+        return;
+
+    // NOTE: the run stops part way through a pass, so allow for one either way
+    const u64 count = stacks[2].second / 9;
+    const auto near = [count](u64 cycles, u64 perPass) {
+        return cycles / perPass + 1 >= count && cycles / perPass <= count + 1;
+    };
+    Check(count > 1000 && near(stacks[1].second, 17) && near(stacks[3].second, 7),
+          "every frame is charged the cycles spent in it");
+
+    // NOTE: both calls into G run its second NOP
+    const u16 g = Symbol(assembler, "G");
+    Check(near(profiler.Cycles()[g], 2) && near(profiler.Cycles()[g + 1], 4),
+          "the flat profile counts the cycles spent at each address");
+
+    std::ostringstream listing;
+    profiler.WriteListing(listing, assembler.lines);
+    Check(listing.str().find(std::format("{:>12}", profiler.Cycles()[g])) != std::string::npos,
+          "the listing shows the cycles spent on each row");
+}
+
+// NOTE: the loop runs before the debugger is attached, so its blocks are already cached, and translated where the
+// translator is built in, when the breakpoint is set
+static void TestBreakpointsAndWatchpoints() {
+    Machine machine;
+    Assembler assembler;
+    LoadProgram(machine, assembler,
+                " ORG $C000\n"
+                "START LDS #$FF\n"
+                " CLRB\n"
+                "LOOP INCB\n"
+                "STORE STAB $40\n"
+                "MARK LDAA $50\n"
+                " BRA LOOP\n");
+    machine.Reset();
+    machine.Run(1000);
+
+    Debugger debugger(machine);
+    const u16 mark = Symbol(assembler, "MARK");
+    debugger.SetBreakpoint(mark);
+
+    debugger.Run(1000);
+    const u8 count = machine.cpu.state.B;
+    Check(debugger.Halted() && machine.cpu.state.PC == mark, "a breakpoint halts the CPU in front of it");
+    Check(debugger.LastStop() && debugger.LastStop()->reason == DebugStop::Reason::Breakpoint,
+          "the halt is put down to the breakpoint");
+
+    debugger.Run(1000);
+    Check(machine.cpu.state.PC == mark && machine.cpu.state.B == static_cast<u8>(count + 1),
+          "running on from a breakpoint goes round the loop once");
+
+    debugger.ClearBreakpoints();
+    debugger.AddWatchpoint({ 0x40, 1, false, true });
+    debugger.Run(1000);
+    const std::optional<DebugStop> &stop = debugger.LastStop();
+    Check(stop && stop->reason == DebugStop::Reason::Write && stop->pc == Symbol(assembler, "STORE")
+          && stop->address == 0x40 && stop->value == static_cast<u8>(count + 2), "a write watchpoint halts the CPU");
+
+    debugger.RemoveWatchpoint(0x40);
+    debugger.AddWatchpoint({ 0x4F, 2, true, false });
+    debugger.Run(1000);
+    Check(stop && stop->reason == DebugStop::Reason::Read && stop->pc == mark && stop->address == 0x50,
+          "a read watchpoint covers every byte of its range");
+
+    debugger.ClearWatchpoints();
+    const u64 cycles = machine.cpu.cycles;
+    debugger.Run(1000);
+    Check(!debugger.Halted() && machine.cpu.cycles >= cycles + 1000,
+          "nothing halts the CPU once everything is cleared");
+}
+
+// NOTE: the steps cover waits on WAI and real-time interrupts, so stepping back has to land in and out of both
+static void TestStepBack() {
+    Machine machine;
+    Assembler assembler;
+    LoadProgram(machine, assembler, RealTimeProgram);
+    SetVector(machine.bus, Vectors::RealTime, Symbol(assembler, "RTIH"));
+    machine.Reset();
+
+    Debugger debugger(machine);
+    debugger.SetCheckpointInterval(10000);
+    debugger.Run(30000);
+
+    struct Position {
+        u64 cycles;
+        u16 pc;
+        u8 ccr;
+        RunState runState;
+    };
+
+    std::vector<Position> positions;
+
+    for (i32 i = 0; i < 40; i++) {
+        const CPUState &state = machine.cpu.state;
+        positions.push_back({ machine.cpu.cycles, state.PC, state.CCR(), machine.cpu.runState });
+        debugger.Step();
+    }
+
+    bool same = true;
+
+    for (auto it = positions.rbegin(); it != positions.rend(); ++it) {
+        same = same && debugger.StepBack() && machine.cpu.cycles == it->cycles && machine.cpu.state.PC == it->pc
+               && machine.cpu.state.CCR() == it->ccr && machine.cpu.runState == it->runState;
+    }
+
+    Check(same, "stepping back retraces the steps taken forward");
+}
+
+int main() {
+    TestInstructionResults();
+    TestCodeInRamIsCached();
+    TestTranslatedMatchesInterpreted();
+    TestSciEcho();
+    TestInterruptEntryAndReturn();
+    TestWaitSkipsIdleTime();
+    TestSnapshotRoundTrip();
+    TestBatchDoesNotDependOnThreads();
+    TestTraceRingAndFile();
+    TestProfilerOutput();
+    TestBreakpointsAndWatchpoints();
+    TestStepBack();
+
+    if (failures > 0) {
+        std::printf("%d checks failed\n", failures);
+        return 1;
+    }
+
+    std::printf("all checks passed%s\n", BlockCache::JitAvailable ? " (with the translator)" : "");
+    return 0;
+}
@@ -0,0 +1,175 @@
+#ifndef M68HC11_THREADPOOL_H
+#define M68HC11_THREADPOOL_H
+
+#include "m68hc11x.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// Fixed set of workers, each with its own task deque. A worker pops its own newest task first and, once it runs dry,
+// steals the oldest task of another worker, so uneven jobs spread out without a single contended queue.
+class WorkStealingPool {
+public:
+    using Task = std::function<void()>;
+
+    explicit WorkStealingPool(sz_t threadCount = std::max(1u, std::thread::hardware_concurrency())) {
+        threadCount = std::max<sz_t>(threadCount, 1);
+
+        for (sz_t i = 0; i < threadCount; i++)
+            workers.push_back(std::make_unique<Worker>());
+
+        for (sz_t i = 0; i < threadCount; i++)
+            threads.emplace_back([this, i] { Run(i); });
+    }
+
+    WorkStealingPool(const WorkStealingPool &) = delete;
+    WorkStealingPool &operator=(const WorkStealingPool &) = delete;
+
+    ~WorkStealingPool() {
+        {
+            std::lock_guard lock(sleepMutex);
+            stopping = true;
+        }
+
+        wake.notify_all();
+
+        for (std::thread &thread : threads)
+            thread.join();
+    }
+
+    [[nodiscard]] sz_t size() const { return workers.size(); }
+
+    // NOTE: tasks submitted from inside a worker go to that worker's own deque, everything else is spread round robin
+    void Submit(Task task) {
+        const sz_t target = currentWorker.pool == this ? currentWorker.index : nextWorker++ % workers.size();
+
+        // NOTE: counted before it becomes visible, so a worker can never take a task the counters do not know about
+        {
+            std::lock_guard lock(sleepMutex);
+            pending++;
+            queued++;
+        }
+
+        {
+            std::lock_guard lock(workers[target]->mutex);
+            workers[target]->tasks.push_back(std::move(task));
+        }
+
+        wake.notify_one();
+    }
+
+    // NOTE: blocks until every submitted task has finished, then rethrows the first exception a task let escape
+    void Wait() {
+        std::unique_lock lock(sleepMutex);
+        idle.wait(lock, [this] { return pending == 0; });
+
+        if (failure)
+            std::rethrow_exception(std::exchange(failure, nullptr));
+    }
+
+    // NOTE: runs body(i) for every i in [0, count) and waits for all of them
+    template<typename Body>
+    void ParallelFor(sz_t count, Body &&body) {
+        for (sz_t i = 0; i < count; i++)
+            Submit([&body, i] { body(i); });
+
+        Wait();
+    }
+
+private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    // NOTE: zero initialized like any other thread_local, so threads outside the pool see no pool
+    struct CurrentWorker {
+        const WorkStealingPool *pool;
+        sz_t index;
+    };
+
+    bool TryTake(sz_t self, Task &task) {
+        {
+            Worker &own = *workers[self];
+            std::lock_guard lock(own.mutex);
+
+            if (!own.tasks.empty()) {
+                task = std::move(own.tasks.back());
+                own.tasks.pop_back();
+                return true;
+            }
+        }
+
+        for (sz_t offset = 1; offset < workers.size(); offset++) {
+            Worker &victim = *workers[(self + offset) % workers.size()];
+            std::lock_guard lock(victim.mutex);
+
+            if (!victim.tasks.empty()) {
+                task = std::move(victim.tasks.front());
+                victim.tasks.pop_front();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void Run(sz_t self) {
+        currentWorker = { this, self };
+
+        while (true) {
+            Task task;
+
+            if (!TryTake(self, task)) {
+                std::unique_lock lock(sleepMutex);
+                wake.wait(lock, [this] { return stopping || queued > 0; });
+
+                if (stopping && queued == 0)
+                    return;
+
+                continue;
+            }
+
+            {
+                std::lock_guard lock(sleepMutex);
+                queued--;
+            }
+
+            try {
+                task();
+            } catch (...) {
+                std::lock_guard lock(sleepMutex);
+                if (!failure)
+                    failure = std::current_exception();
+            }
+
+            std::lock_guard lock(sleepMutex);
+            if (--pending == 0)
+                idle.notify_all();
+        }
+    }
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    std::atomic<sz_t> nextWorker = 0;
+
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    sz_t pending = 0;
+    sz_t queued = 0;
+    bool stopping = false;
+    std::exception_ptr failure;
+
+    static inline thread_local CurrentWorker currentWorker;
+};
+
+#endif //M68HC11_THREADPOOL_H
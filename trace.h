@@ -0,0 +1,343 @@
+#ifndef M68HC11_TRACE_H
+#define M68HC11_TRACE_H
+
+#include "cpu.h"
+#include "m68hc11x.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <span>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+// NOTE: one traced instruction and the registers as they were when it started
+struct TraceEntry {
+    u16 pc;
+    // NOTE: 0 for instructions without a prefix byte
+    u8 prefix;
+    u8 opcode;
+    u8 A;
+    u8 B;
+    u16 IX;
+    u16 IY;
+    u16 SP;
+    u8 ccr;
+};
+
+// Records the instructions a Cpu executes into a ring of fixed-size chunks, the newest overwriting the oldest, so the
+// last chunkCount chunks of history are always at hand. Each record is delta encoded against the one before: a mask
+// byte, PC only when execution did not just fall through to the next instruction, the opcode, and only the registers
+// that changed, which takes three bytes for a typical instruction. Every chunk starts with a full record and decodes
+// on its own.
+//
+// StartStreaming also writes every chunk to a file, from a background thread that takes them off the ring as they
+// fill up. The two threads only share the head and tail counters, and a full ring makes the CPU wait for the writer
+// rather than lose records.
+class TraceBuffer {
+public:
+    static constexpr sz_t ChunkSize = 1 << 16;
+    static constexpr char FileMagic[8] = { 'H', 'C', '1', '1', 'T', 'R', 'C', '1' };
+
+    explicit TraceBuffer(sz_t chunkCount = 64) : storage(std::max<sz_t>(chunkCount, 2) * ChunkSize),
+                                                 used(std::max<sz_t>(chunkCount, 2)) {}
+
+    TraceBuffer(const TraceBuffer &) = delete;
+    TraceBuffer &operator=(const TraceBuffer &) = delete;
+
+    ~TraceBuffer() {
+        StopStreaming();
+    }
+
+    void Record(const Cpu &cpu) {
+        if (offset + MaxRecordSize > ChunkSize) [[unlikely]]
+            Publish();
+
+        const CPUState &state = cpu.state;
+        u8 *record = Chunk(head.load(std::memory_order_relaxed)) + offset;
+        u8 *out = record + 1;
+        u8 mask = 0;
+
+        if (keyframe || state.PC != nextPC) {
+            mask |= PcChanged;
+            out = Put16(out, state.PC);
+        }
+
+        const u8 first = cpu.bus.Peek(state.PC);
+        const u8 second = cpu.bus.Peek(state.PC + 1);
+        const bool prefixed = IsPrefix(first);
+
+        *out++ = first;
+        if (prefixed)
+            *out++ = second;
+
+        nextPC = state.PC + Length(first, second);
+
+        if (keyframe || state.A != last.A) {
+            mask |= AChanged;
+            *out++ = state.A;
+        }
+
+        if (keyframe || state.B != last.B) {
+            mask |= BChanged;
+            *out++ = state.B;
+        }
+
+        if (keyframe || state.IX != last.IX) {
+            mask |= IxChanged;
+            out = Put16(out, state.IX);
+        }
+
+        if (keyframe || state.IY != last.IY) {
+            mask |= IyChanged;
+            out = Put16(out, state.IY);
+        }
+
+        if (keyframe || state.SP != last.SP) {
+            mask |= SpChanged;
+            out = Put16(out, state.SP);
+        }
+
+        const u8 ccr = state.CCR();
+
+        if (keyframe || ccr != last.ccr) {
+            mask |= CcrChanged;
+            *out++ = ccr;
+        }
+
+        *record = mask;
+        offset = out - Chunk(head.load(std::memory_order_relaxed));
+        last = { state.PC, 0, 0, state.A, state.B, state.IX, state.IY, state.SP, ccr };
+        keyframe = false;
+        recorded++;
+    }
+
+    // NOTE: hands the chunk being filled to the writer now instead of when it is full
+    void Flush() {
+        if (offset > 0)
+            Publish();
+    }
+
+    // NOTE: decodes what the ring still holds, oldest first; only for the thread that records
+    template<typename Fn>
+    void ForEach(Fn &&fn) const {
+        const u64 published = head.load(std::memory_order_relaxed);
+        const u64 retained = std::min<u64>(published, used.size() - 1);
+
+        for (u64 chunk = published - retained; chunk < published; chunk++)
+            Decode(std::span(Chunk(chunk), used[chunk % used.size()]), fn);
+
+        Decode(std::span(Chunk(published), offset), fn);
+    }
+
+    // NOTE: instructions recorded since construction, including the ones overwritten since
+    [[nodiscard]] u64 Recorded() const { return recorded; }
+
+    // NOTE: the chunks still in the ring are written first, then everything recorded until StopStreaming
+    void StartStreaming(const std::string &path) {
+        StopStreaming();
+
+        file.open(path, std::ios::binary | std::ios::trunc);
+
+        if (!file)
+            throw std::runtime_error(std::format("Failed to open {}", path));
+
+        file.write(FileMagic, sizeof(FileMagic));
+
+        const u64 published = head.load(std::memory_order_relaxed);
+        tail.store(published - std::min<u64>(published, used.size() - 1), std::memory_order_relaxed);
+        stopping.store(false, std::memory_order_relaxed);
+        streaming = true;
+        writer = std::thread([this] { Write(); });
+    }
+
+    // NOTE: flushes what has been recorded and waits until it is all in the file
+    void StopStreaming() {
+        if (!streaming)
+            return;
+
+        Flush();
+        stopping.store(true, std::memory_order_release);
+        Wake();
+        writer.join();
+
+        streaming = false;
+        file.close();
+    }
+
+    // NOTE: decodes one chunk as it is stored in the ring and in a trace file
+    template<typename Fn>
+    static void Decode(std::span<const u8> chunk, Fn &&fn) {
+        TraceEntry entry {};
+        u16 nextPC = 0;
+        sz_t i = 0;
+
+        while (i < chunk.size()) {
+            const u8 mask = chunk[i++];
+
+            entry.pc = mask & PcChanged ? Get16(chunk, i) : nextPC;
+            entry.prefix = IsPrefix(chunk[i]) ? chunk[i++] : 0;
+            entry.opcode = chunk[i++];
+            nextPC = entry.pc + (entry.prefix ? Length(entry.prefix, entry.opcode) : Length(entry.opcode, 0));
+
+            if (mask & AChanged)
+                entry.A = chunk[i++];
+            if (mask & BChanged)
+                entry.B = chunk[i++];
+            if (mask & IxChanged)
+                entry.IX = Get16(chunk, i);
+            if (mask & IyChanged)
+                entry.IY = Get16(chunk, i);
+            if (mask & SpChanged)
+                entry.SP = Get16(chunk, i);
+            if (mask & CcrChanged)
+                entry.ccr = chunk[i++];
+
+            fn(static_cast<const TraceEntry &>(entry));
+        }
+    }
+
+    // NOTE: decodes a whole file written by StartStreaming
+    template<typename Fn>
+    static void ReadFile(const std::string &path, Fn &&fn) {
+        std::ifstream in(path, std::ios::binary);
+        char magic[sizeof(FileMagic)] = {};
+
+        if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, FileMagic, sizeof(magic)) != 0)
+            throw std::runtime_error(std::format("{} is not a trace file", path));
+
+        std::vector<u8> chunk;
+        u8 size[4];
+
+        while (in.read(reinterpret_cast<char *>(size), sizeof(size))) {
+            chunk.resize(size[0] | size[1] << 8 | size[2] << 16 | u32(size[3]) << 24);
+
+            if (!in.read(reinterpret_cast<char *>(chunk.data()), static_cast<std::streamsize>(chunk.size())))
+                throw std::runtime_error(std::format("{} is truncated", path));
+
+            Decode(chunk, fn);
+        }
+    }
+
+private:
+    static constexpr u8 AChanged = 0x01;
+    static constexpr u8 BChanged = 0x02;
+    static constexpr u8 IxChanged = 0x04;
+    static constexpr u8 IyChanged = 0x08;
+    static constexpr u8 SpChanged = 0x10;
+    static constexpr u8 CcrChanged = 0x20;
+    static constexpr u8 PcChanged = 0x40;
+
+    // NOTE: mask, PC, two opcode bytes, A, B, IX, IY, SP and CCR
+    static constexpr sz_t MaxRecordSize = 14;
+
+    static bool IsPrefix(u8 byte) {
+        return byte == 0x18 || byte == 0x1A || byte == 0xCD;
+    }
+
+    // NOTE: second only counts after a prefix
+    static u16 Length(u8 first, u8 second) {
+        for (sz_t page = 1; page < PagePrefixes.size(); page++) {
+            if (first == PagePrefixes[page])
+                return 2 + DecodeTables[page][second].operandBytes;
+        }
+
+        return 1 + DecodeTables[0][first].operandBytes;
+    }
+
+    static u8 *Put16(u8 *out, u16 value) {
+        out[0] = static_cast<u8>(value);
+        out[1] = static_cast<u8>(value >> 8);
+        return out + 2;
+    }
+
+    static u16 Get16(std::span<const u8> chunk, sz_t &i) {
+        const u16 value = chunk[i] | chunk[i + 1] << 8;
+        i += 2;
+        return value;
+    }
+
+    [[nodiscard]] u8 *Chunk(u64 index) { return &storage[(index % used.size()) * ChunkSize]; }
+    [[nodiscard]] const u8 *Chunk(u64 index) const { return &storage[(index % used.size()) * ChunkSize]; }
+
+    void Publish() {
+        const u64 published = head.load(std::memory_order_relaxed);
+        used[published % used.size()] = static_cast<u32>(offset);
+        head.store(published + 1, std::memory_order_release);
+
+        offset = 0;
+        keyframe = true;
+
+        if (streaming) {
+            Wake();
+
+            // NOTE: the next chunk may still be waiting for the writer
+            for (u64 written = tail.load(std::memory_order_acquire); published + 1 - written >= used.size();
+                 written = tail.load(std::memory_order_acquire)) {
+                tail.wait(written, std::memory_order_acquire);
+            }
+        }
+    }
+
+    void Wake() {
+        wakeups.fetch_add(1, std::memory_order_release);
+        wakeups.notify_one();
+    }
+
+    void Write() {
+        while (true) {
+            const u32 seen = wakeups.load(std::memory_order_acquire);
+            const u64 written = tail.load(std::memory_order_relaxed);
+
+            if (written == head.load(std::memory_order_acquire)) {
+                if (stopping.load(std::memory_order_acquire))
+                    return;
+
+                wakeups.wait(seen, std::memory_order_acquire);
+                continue;
+            }
+
+            const u32 size = used[written % used.size()];
+            const u8 header[4] = { static_cast<u8>(size), static_cast<u8>(size >> 8), static_cast<u8>(size >> 16),
+                                   static_cast<u8>(size >> 24) };
+
+            file.write(reinterpret_cast<const char *>(header), sizeof(header));
+            file.write(reinterpret_cast<const char *>(Chunk(written)), size);
+
+            tail.store(written + 1, std::memory_order_release);
+            tail.notify_one();
+        }
+    }
+
+    std::vector<u8> storage;
+    std::vector<u32> used;
+
+    // NOTE: chunks published by the recording thread and chunks written out by the writer
+    std::atomic<u64> head = 0;
+    std::atomic<u64> tail = 0;
+    std::atomic<u32> wakeups = 0;
+    std::atomic<bool> stopping = false;
+
+    sz_t offset = 0;
+    bool keyframe = true;
+    u16 nextPC = 0;
+    TraceEntry last {};
+    u64 recorded = 0;
+
+    bool streaming = false;
+    std::ofstream file;
+    std::thread writer;
+};
+
+// NOTE: the trace policy that records into Cpu::trace, which has to be set
+struct Traced {
+    static constexpr bool Enabled = true;
+
+    static void Record(const Cpu &cpu) { cpu.trace->Record(cpu); }
+    static void Interrupt(const Cpu &) {}
+};
+
+#endif //M68HC11_TRACE_H